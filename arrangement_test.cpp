@@ -43,6 +43,49 @@ void get_arrangement(std::filesystem::path& input_path,
     slope_subdiv.export_to_svg(output_path.string(), bounding_box.first.first, bounding_box.first.second);
 }
 
+/**
+ * @brief Compares the HN filtrations read off the subdivision of the first local cell of M 
+ * with those of the search at samples x samples points inside the cell. Returns the number of points where they differ.
+ */
+int compare_with_search(const R2GradedSparseMatrix<int>& M, const pair<r2degree>& bounds, int samples) {
+    r2degree cell_start = {M.x_grid[0], M.y_grid[0]};
+    r2degree cell_boundary = {M.x_grid[1], M.y_grid[1]};
+    Uni_B1 X(M);
+    auto subdivision = compute_cell_subdivision(X, bounds, cell_start, cell_boundary);
+    if (!subdivision) {
+        std::cout << "No subdivision of the cell " << cell_start << " to " << cell_boundary << ", nothing to compare." << std::endl;
+        return 0;
+    }
+    r2degree extent = cell_boundary - cell_start;
+    int num_mismatches = 0;
+    for (int a = 0; a < samples; a++) {
+        for (int b = 0; b < samples; b++) {
+            // Away from the boundary of the cell, where the relations of the search change.
+            r2degree shift = {extent.first * (a + 0.5) / samples, extent.second * (b + 0.5) / samples};
+            HN_factors from_subdivision;
+            bool located = hnf_from_subdivision(*subdivision, shift, bounds, from_subdivision);
+            R2GradedSparseMatrix<int> cut_off = M;
+            cut_off.set_all_generator_degrees(cell_start + shift);
+            vec<HN_factors> from_search;
+            skyscraper_invariant(cut_off, from_search, bounds);
+            bool same = located && from_search.size() == 1 && from_search[0].size() == from_subdivision.size();
+            for (size_t f = 0; same && f < from_subdivision.size(); f++) {
+                const Uni_B1& expected = from_search[0][f];
+                const Uni_B1& found = from_subdivision[f];
+                same = expected.d1.get_num_rows() == found.d1.get_num_rows()
+                    && std::abs(expected.slope_value - found.slope_value) <= 1e-9 * std::abs(expected.slope_value);
+            }
+            if (!same) {
+                num_mismatches++;
+                std::cout << "  Subdivision and search differ at " << cell_start + shift << std::endl;
+            }
+        }
+    }
+    std::cout << "Compared the subdivision with the search at " << samples * samples << " points, "
+        << num_mismatches << " differ." << std::endl;
+    return num_mismatches;
+}
+
 int main(int argc, char** argv) {
     std::string filepath;
     int optional_value = 0;  // default value
@@ -75,5 +118,12 @@ int main(int argc, char** argv) {
     
     get_arrangement(input_path, output_path, optional_value);
 
+    R2GradedSparseMatrix<int> M(input_path.string());
+    M.compute_grid_representation();
+    if (M.get_num_rows() > 1 && M.x_grid.size() >= 2 && M.y_grid.size() >= 2) {
+        if (compare_with_search(M, M.bounding_box(), 10) > 0) {
+            return 1;
+        }
+    }
     return 0;
 }
\ No newline at end of file
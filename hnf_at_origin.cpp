@@ -8,7 +8,6 @@ using namespace hnf;
 void hnf_at_origin(std::filesystem::path input_path, r2degree upper_bound, bool filter) {
     
     R2GradedSparseMatrix<int> X = R2GradedSparseMatrix<int>(input_path.string());
-    int dim = X.get_num_rows();
     pair<r2degree> bounds = X.bounding_box();
     if(upper_bound != r2degree{0,0}){
         bounds.second = upper_bound;
@@ -17,9 +16,9 @@ void hnf_at_origin(std::filesystem::path input_path, r2degree upper_bound, bool
         r2degree range = bounds.second - bounds.first;
         bounds.second = bounds.second + r2degree{padding*range.first, padding*range.second};
     }
-    vec<vec<vec<SparseMatrix<int>>>> subspaces = sparse_seperated_grassmannians<int>(dim);
     vec<HN_factors> result;
-    skyscraper_invariant(X, result, subspaces, bounds, filter);
+    // Small dimensions use the shared subspace table, larger ones stream the subspaces.
+    skyscraper_invariant(X, result, bounds, filter);
     assert(result.size() == 1);
     for(auto& factor : result[0]){
         std::cout << "Slope: " << factor.slope_value << " Module: \n";
@@ -12,9 +12,14 @@ struct ProgramConfig {
     bool is_decomposed = false;
     bool dynamic_grid = true;
     bool subdivision = false;
+    bool binary_output = false;
+    bool hdf5_output = false;
+    bool dictionary_output = false;
     int grid_length_x = 200;
     int grid_length_y = 200;
     int grassmann_value = -1;
+    hnf::Sweep_options sweep_options;
+    std::string grassmann_cache;
     std::string output_string;
 };
 
@@ -99,13 +104,24 @@ bool parse_command_line(int argc, char** argv, ProgramConfig& config) {
         {"dynamic_grid", no_argument, 0, 'y'},
         {"subdivision", no_argument, 0, 'u'},
         {"grassmann", required_argument, 0, 'k'},
+        {"threads", required_argument, 0, 'n'},
+        {"summand_tasks", no_argument, 0, 'm'},
+        {"work_stealing", no_argument, 0, 'w'},
+        {"grassmann_cache", required_argument, 0, 'a'},
+        {"exhaustive_hnf", no_argument, 0, 'i'},
+        {"no_hnf_cache", no_argument, 0, 'z'},
+        {"regions", no_argument, 0, 'R'},
+        {"pipeline", no_argument, 0, 'q'},
+        {"binary", no_argument, 0, 'B'},
+        {"hdf5", no_argument, 0, 'H'},
+        {"dictionary", no_argument, 0, 'D'},
         {0, 0, 0, 0}
     };
     
     int opt;
     int option_index = 0;
     
-    while ((opt = getopt_long(argc, argv, "ho::gestr:pclfjxdyk:ub", long_options, &option_index)) != -1) {
+    while ((opt = getopt_long(argc, argv, "ho::gestr:pclfjxdyk:ubn:mwa:izRqBHD", long_options, &option_index)) != -1) {
         switch (opt) {
             case 'b':
                 config.decomposer.config.brute_force = true;
@@ -175,6 +191,7 @@ bool parse_command_line(int argc, char** argv, ProgramConfig& config) {
                 break;
             case 'u':
                 config.subdivision = true;
+                hnf::hnf_search_config().slope_subdivision = true;
                 break;
             case 'k':
                 if (!optarg) {
@@ -183,6 +200,57 @@ bool parse_command_line(int argc, char** argv, ProgramConfig& config) {
                 }
                 config.grassmann_value = std::stoi(optarg);
                 break;
+            case 'n':
+                if (!optarg) {
+                    std::cerr << "Error: --threads requires an integer argument." << std::endl;
+                    return false;
+                }
+                config.sweep_options.num_threads = std::stoi(optarg);
+                if (config.sweep_options.num_threads < 1) {
+                    config.sweep_options.num_threads = hnf::default_num_threads();
+                }
+                break;
+            case 'm':
+                config.sweep_options.per_summand_tasks = true;
+                break;
+            case 'w':
+                config.sweep_options.cell_tasks = true;
+                break;
+            case 'a':
+                if (!optarg) {
+                    std::cerr << "Error: --grassmann_cache requires a file argument." << std::endl;
+                    return false;
+                }
+                config.grassmann_cache = std::string(optarg);
+                break;
+            case 'i':
+                hnf::hnf_search_config().branch_and_bound = false;
+                break;
+            case 'z':
+                hnf::hnf_search_config().memo_cache = false;
+                break;
+            case 'R':
+                config.sweep_options.region_output = true;
+                // Regions live on the local grids, so they need the dynamic grid.
+                config.dynamic_grid = true;
+                break;
+            case 'q':
+                config.sweep_options.pipeline = true;
+                break;
+            case 'B':
+                config.binary_output = true;
+                break;
+            case 'H':
+#ifdef SKYSCRAPER_HDF5
+                config.hdf5_output = true;
+                break;
+#else
+                std::cerr << "Error: hnf_main was built without HDF5, configure with -DWITH_HDF5=ON." << std::endl;
+                return false;
+#endif
+            case 'D':
+                config.dictionary_output = true;
+                break;
             default:
                 return false;
         }
@@ -228,7 +296,11 @@ FileInfo resolve_input_file(int argc, char** argv, bool test_files, bool& is_dec
     return file_info;
 }
 
-bool process_input_file(const FileInfo& file_info, ProgramConfig& config, std::ostringstream& ostream) {
+/**
+ * @brief Runs the sweep on the input file. ostream is the text output or a Sky_cell_sink which receives the cells directly.
+ */
+template<typename Outputstream>
+bool process_input_file(const FileInfo& file_info, ProgramConfig& config, Outputstream& ostream) {
     std::ifstream istream(file_info.matrix_path);
     if (!istream.is_open()) {
         std::cerr << "Error: Could not open input file: " << file_info.matrix_path << std::endl;
@@ -239,8 +311,11 @@ bool process_input_file(const FileInfo& file_info, ProgramConfig& config, std::o
         ? "Running HNF on already decomposed input file: " 
         : "First decomposing with AIDA.") + file_info.filename << std::endl;
     
-    ostream << std::fixed << std::setprecision(8);
-    std::cout << "Computing HNF decomposition over " << config.grid_length_x << "x" << config.grid_length_y << " grid." << std::endl;
+    std::cout << "Computing HNF decomposition over " << config.grid_length_x << "x" << config.grid_length_y << " grid";
+    if (config.sweep_options.num_threads > 1) {
+        std::cout << " with " << config.sweep_options.num_threads << " threads";
+    }
+    std::cout << "." << std::endl;
     hnf::full_grid_induced_decomposition(
         config.decomposer, istream, ostream, 
         config.show_indecomp_statistics, 
@@ -249,7 +324,8 @@ bool process_input_file(const FileInfo& file_info, ProgramConfig& config, std::o
         config.is_decomposed, 
         config.grid_length_x, 
         config.grid_length_y, 
-        config.grassmann_value
+        config.grassmann_value,
+        config.sweep_options
     );
     
     return true;
@@ -268,11 +344,6 @@ void output_base_change_statistics(const ProgramConfig& config) {
     }
 }
 
-void write_output(const std::ostringstream& ostream, const FileInfo& file_info, const std::string& output_string) {
-    std::string output_file_path;
-    hnf::write_to_file(ostream, output_file_path, file_info.input_directory, 
-        file_info.file_without_extension, file_info.extension, output_string);
-}
 
 int main(int argc, char** argv) {
     ProgramConfig config;
@@ -287,21 +358,91 @@ int main(int argc, char** argv) {
     if (!parse_command_line(argc, argv, config)) {
         return 0; // Help/version shown or error occurred
     }
+
+    if (!config.grassmann_cache.empty()) {
+        hnf::Grassmannian_table::attach(config.grassmann_cache);
+    }
     
     FileInfo file_info = resolve_input_file(argc, argv, config.test_files, config.is_decomposed);
+    if (config.sweep_options.region_output) {
+        file_info.extension = ".skr";
+        if (config.binary_output || config.hdf5_output || config.dictionary_output) {
+            std::cout << "Region files have no binary, HDF5 or dictionary format, writing text." << std::endl;
+            config.binary_output = false;
+            config.hdf5_output = false;
+            config.dictionary_output = false;
+        }
+    } else if (config.binary_output + config.hdf5_output + config.dictionary_output > 1) {
+        std::cerr << "Error: Choose only one of --binary, --hdf5 and --dictionary." << std::endl;
+        return 1;
+    } else if (config.hdf5_output) {
+        file_info.extension = ".h5";
+    } else if (config.binary_output) {
+        file_info.extension = ".skb";
+    } else if (config.dictionary_output) {
+        file_info.extension = ".skd";
+    }
     
     if (!config.test_files) {
-        std::ostringstream ostream;
-        if (!process_input_file(file_info, config, ostream)) {
+        // The output is streamed to disk while the grid is computed. Without -o it is discarded.
+        std::string output_file_path;
+        if (config.write_output) {
+            output_file_path = hnf::resolve_output_path(file_info.input_directory, 
+                file_info.file_without_extension, file_info.extension, config.output_string);
+        }
+        // The HDF5 library writes its file itself, the text stream is only parsed.
+        hnf::Sky_stream_writer file_stream(config.hdf5_output ? std::string() : output_file_path);
+        if (!file_stream.is_open()) {
+            std::cerr << "Error: Could not open output file: " << output_file_path << std::endl;
             return 1;
         }
+        std::unique_ptr<hnf::Sky_cell_sink> sink;
+        if (config.binary_output) {
+            sink = std::make_unique<hnf::Sky_binary_builder>(file_stream);
+        } else if (config.dictionary_output) {
+            sink = std::make_unique<hnf::Sky_dictionary_builder>(file_stream);
+        }
+#ifdef SKYSCRAPER_HDF5
+        if (config.hdf5_output && config.write_output) {
+            sink = std::make_unique<hnf::Sky_hdf5_writer>(output_file_path);
+        }
+#endif
+        // The binary, dictionary and HDF5 writers get the doubles of the sweep directly, without a detour through text.
+        bool processed;
+        if (sink) {
+            processed = process_input_file(file_info, config, *sink);
+            if (processed) {
+                sink->finish();
+            }
+        } else {
+            file_stream << std::fixed << std::setprecision(8);
+            processed = process_input_file(file_info, config, static_cast<std::ostream&>(file_stream));
+        }
+        if (!processed) {
+            return 1;
+        }
+        bool written = file_stream.close();
         
         output_base_change_statistics(config);
         
+        if (config.show_runtime_statistics) {
+            hnf::HNF_cache::print_statistics();
+        }
+        
         if (config.write_output) {
-            write_output(ostream, file_info, config.output_string);
+            if (written) {
+                std::cout << "HN filtration written to " << output_file_path << std::endl;
+            } else {
+                std::cout << "Error: Could not write HN filtration to file: " << output_file_path << std::endl;
+            }
         }
     }
+
+    // Only rewrite the cached table if this run needed more dimensions than it holds.
+    if (!config.grassmann_cache.empty() 
+        && hnf::Grassmannian_table::loaded_dim() > hnf::Grassmannian_table::file_dim()) {
+        hnf::Grassmannian_table::save(config.grassmann_cache, hnf::Grassmannian_table::loaded_dim());
+    }
     
     return 0;
 }
\ No newline at end of file
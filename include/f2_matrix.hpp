@@ -0,0 +1,90 @@
+#pragma once
+
+#ifndef F2_MATRIX_HPP
+#define F2_MATRIX_HPP
+
+#include "uni_b1.hpp"
+#include <cstdint>
+
+namespace hnf {
+
+/**
+ * @brief Dense matrix over F_2 with at most 64 rows, every column is a bitmask of its rows.
+ * Replaces the sparse columns of SparseMatrix<int> for the small presentations which occur in the HNF search.
+ */
+struct F2_matrix {
+    int num_rows = 0;
+    vec<uint64_t> columns;
+
+    F2_matrix() = default;
+    F2_matrix(int num_rows, vec<uint64_t> columns) : num_rows(num_rows), columns(std::move(columns)) {}
+    explicit F2_matrix(const SparseMatrix<int>& M);
+
+    int get_num_cols() const { return columns.size(); }
+
+    /**
+     * @brief Writes the columns back as sorted lists of row indices.
+     */
+    vec<vec<int>> to_sparse_columns() const;
+
+    int rank() const;
+};
+
+/**
+ * @brief Rank of the vectors v[0], ..., v[n-1] over F_2.
+ */
+int rank_of(const uint64_t* v, int n);
+
+/**
+ * @brief Fully reduced echelon basis of a span of bitmasks, the pivot of a vector is its highest bit.
+ */
+struct F2_echelon_basis {
+    vec<uint64_t> vectors;
+    // Union of the pivots of all vectors.
+    uint64_t pivots = 0;
+
+    int dim() const { return vectors.size(); }
+
+    uint64_t normal_form(uint64_t v) const {
+        for(uint64_t b : vectors){
+            uint64_t pivot = uint64_t(1) << (63 - __builtin_clzll(b));
+            v ^= b & -((v & pivot) != 0);
+        }
+        return v;
+    }
+
+    bool contains(uint64_t v) const { return normal_form(v) == 0; }
+
+    /**
+     * @brief Adds v to the span, returns false if it was already contained.
+     */
+    bool add(uint64_t v);
+};
+
+/**
+ * @brief True if the F_2 kernels below can handle X: all generators in the same degree and at most 64 of them.
+ */
+bool f2_kernel_applies(const R2Mat& X);
+
+/**
+ * @brief Minimal presentation of the submodule of X generated by the columns of subspace,
+ * which have to be linearly independent and lie in the degree of the generators. Same as
+ * X.submodule_generated_by(subspace) followed by minimize.
+ */
+R2Mat f2_submodule_generated_by(const R2Mat& X, const SparseMatrix<int>& subspace);
+
+/**
+ * @brief Replaces X by a minimal presentation of its quotient by the submodule generated by subspace.
+ * The generators of the quotient are those of X which are not a pivot of the echelon form of subspace.
+ */
+void f2_quotient_by(R2Mat& X, const SparseMatrix<int>& subspace);
+
+/**
+ * @brief Removes all relations of X which are generated by relations of smaller degree,
+ * and all generators which are killed in their own degree.
+ */
+void f2_minimize(R2Mat& X);
+
+} // namespace hnf
+
+#endif // F2_MATRIX_HPP
@@ -20,6 +20,7 @@ struct GridData {
 };
 
 // Function declarations
+// Reads a .sky file, in the text, the binary or the dictionary encoded format.
 GridData bars_from_sky(const std::string& filename);
 } // namespace hnf
 
@@ -0,0 +1,223 @@
+#pragma once
+
+#ifndef GRASSMANNIAN_TABLE_HPP
+#define GRASSMANNIAN_TABLE_HPP
+
+#include "grlina/graded_linalg.hpp"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+
+using namespace graded_linalg;
+
+namespace hnf {
+
+/**
+ * @brief Process-wide table of all subspaces of F_2^k, sorted by dimension.
+ * get(k)[d] lists the subspaces of dimension d, as the columns of a sparse k x d matrix,
+ * in the same layout as sparse_seperated_grassmannians(k)[k-1].
+ * Every k is built once, on first use, and never changes afterwards:
+ * references stay valid for the whole run and all threads share the same copy.
+ *
+ * The table can be written to a binary file with save. A later run can attach that file:
+ * it is memory-mapped and checked once, and each dimension is decoded from it on first use instead of being enumerated again.
+ * The decoded lists are what get returns and what the threads share, the mapping only spares the enumeration.
+ *
+ * The sweeps take the subspaces of every dimension from here, also for the submodules induced at a grid point.
+ */
+struct Grassmannian_table {
+
+    // Beyond this the table does not fit into memory anymore, use Grassmannian_enumerator instead.
+    static constexpr int max_dim = 7;
+
+    static const vec<vec<SparseMatrix<int>>>& get(int k);
+
+    /**
+     * @brief Memory-maps a file written by save. Has to be called before the first call to get.
+     * Returns false if the file does not exist, or if its header, a block offset or the count and columns
+     * of any subspace do not match a table of this version inside the size of the file.
+     */
+    static bool attach(const std::string& path);
+
+    /**
+     * @brief Writes all dimensions up to k (building them if necessary) to a binary file.
+     */
+    static void save(const std::string& path, int k);
+
+    /**
+     * @brief Largest k which has been built or attached so far.
+     */
+    static int loaded_dim();
+
+    /**
+     * @brief Largest k stored in the attached file, 0 if there is none.
+     */
+    static int file_dim();
+
+  private:
+    struct Mapped_file;
+
+    std::array<std::once_flag, max_dim + 1> built;
+    std::array<std::unique_ptr<vec<vec<SparseMatrix<int>>>>, max_dim + 1> subspaces;
+    std::unique_ptr<Mapped_file> mapped;
+
+    static Grassmannian_table& instance();
+    Grassmannian_table();
+    ~Grassmannian_table();
+    void build(int k);
+};
+
+/**
+ * @brief Enumerates the subspaces of dimension d of F_2^k one at a time, without storing them.
+ * Every subspace is visited exactly once, as its reduced row echelon form: 
+ * the pivot columns run through all d-subsets of {0,..,k-1} and, for each of them, 
+ * the entries right of the pivots which are not in a pivot column through all bit patterns, in Gray code order.
+ * So within a set of pivots, consecutive subspaces differ in a single entry of a single row, see last_change.
+ * The state is O(k^2), independent of the number of subspaces. Needs k <= 64, rows are bitmasks.
+ */
+struct Grassmannian_enumerator {
+
+    Grassmannian_enumerator(int k, int d);
+
+    /**
+     * @brief Writes the next subspace to subspace, as d columns with k rows. Returns false once all have been visited.
+     */
+    bool next(SparseMatrix<int>& subspace);
+
+    /**
+     * @brief Moves to the next subspace without writing it out. Returns false once all have been visited.
+     */
+    bool advance();
+
+    /**
+     * @brief Rows of the echelon form of the current subspace, as bitmasks.
+     */
+    const vec<uint64_t>& basis_rows() const { return rows; }
+
+    /**
+     * @brief (row, column) of the entry in which the current subspace differs from the previous one,
+     * or (-1, -1) if the pivots have changed as well.
+     */
+    std::pair<int,int> last_change() const { return change; }
+
+    /**
+     * @brief Calls f on every remaining subspace.
+     */
+    template<typename F>
+    void for_each(F&& f) {
+        SparseMatrix<int> subspace;
+        while(next(subspace)){
+            f(static_cast<const SparseMatrix<int>&>(subspace));
+        }
+    }
+
+  private:
+    int k;
+    int d;
+    bool done = false;
+    vec<int> pivots;
+    // (row, column) of every entry which is not fixed by the echelon form, up to d*(k-d) of them.
+    vec<std::pair<int,int>> free_entries;
+    // Counts through the 2^|free_entries| patterns of the free entries, in words of 64 bits, lowest word first.
+    vec<uint64_t> free_pattern;
+    bool started = false;
+    vec<uint64_t> rows;
+    std::pair<int,int> change = {-1, -1};
+
+    void set_free_entries();
+    bool next_pivots();
+    bool pattern_is_zero() const;
+    void increment_pattern();
+};
+
+/**
+ * @brief A subspace of F_2^K for small K, as the rows of its reduced row echelon form, 
+ * with the pivots in the lowest bits as in Grassmannian_enumerator.
+ */
+template<int K>
+struct Fixed_subspace {
+    static_assert(1 <= K && K <= 8, "Fixed_subspace stores rows as bytes");
+    int dim = 0;
+    std::array<uint8_t, K> rows{};
+};
+
+/**
+ * @brief Number of entries right of a pivot which are not in a pivot column.
+ */
+template<int K>
+constexpr int num_free_entries(int pivots) {
+    int result = 0;
+    for(int p = 0; p < K; p++){
+        if(pivots & (1 << p)){
+            for(int q = p + 1; q < K; q++){
+                result += !(pivots & (1 << q));
+            }
+        }
+    }
+    return result;
+}
+
+template<int K>
+constexpr int num_fixed_subspaces() {
+    int result = 0;
+    for(int pivots = 1; pivots < (1 << K); pivots++){
+        result += 1 << num_free_entries<K>(pivots);
+    }
+    return result;
+}
+
+template<int K>
+constexpr std::array<Fixed_subspace<K>, num_fixed_subspaces<K>()> build_fixed_grassmannian() {
+    std::array<Fixed_subspace<K>, num_fixed_subspaces<K>()> result{};
+    int next = 0;
+    for(int d = 1; d <= K; d++){
+        for(int pivots = 1; pivots < (1 << K); pivots++){
+            if(__builtin_popcount(pivots) != d){
+                continue;
+            }
+            int pivot_list[K] = {};
+            int free_rows[K*K] = {};
+            int free_columns[K*K] = {};
+            int num_free = 0;
+            int r = 0;
+            for(int p = 0; p < K; p++){
+                if(pivots & (1 << p)){
+                    pivot_list[r] = p;
+                    for(int q = p + 1; q < K; q++){
+                        if(!(pivots & (1 << q))){
+                            free_rows[num_free] = r;
+                            free_columns[num_free] = q;
+                            num_free++;
+                        }
+                    }
+                    r++;
+                }
+            }
+            for(int pattern = 0; pattern < (1 << num_free); pattern++){
+                Fixed_subspace<K>& subspace = result[next++];
+                subspace.dim = d;
+                for(int row = 0; row < d; row++){
+                    subspace.rows[row] = uint8_t(1) << pivot_list[row];
+                }
+                for(int e = 0; e < num_free; e++){
+                    if(pattern & (1 << e)){
+                        subspace.rows[free_rows[e]] |= uint8_t(1) << free_columns[e];
+                    }
+                }
+            }
+        }
+    }
+    return result;
+}
+
+/**
+ * @brief The nonzero subspaces of F_2^K, generated at compile time and sorted by dimension.
+ */
+template<int K>
+inline constexpr auto fixed_grassmannian = build_fixed_grassmannian<K>();
+
+} // namespace hnf
+
+#endif // GRASSMANNIAN_TABLE_HPP
@@ -5,19 +5,32 @@
 
 #include "aida_interface.hpp"
 #include "hnf_at.hpp"
+#include "grassmannian_table.hpp"
+#include "hnf_cache.hpp"
+#include "subdivision_lookup.hpp"
+#include "thread_pool.hpp"
+#include "sky_binary.hpp"
 #include <unistd.h>
 #include <getopt.h>
-// #include <H5Cpp.h> For new better hdf5 output
+#include <queue>
+#include <stdexcept>
 
-
-// using namespace H5; For new version
-// To-Do: Implement hdf5 output for the skyscraper invariant
 using namespace graded_linalg;
 
 namespace hnf{
 
 void display_help();
 void display_version();
+
+/**
+* @brief Path of the output file: output_string if it names a file, 
+* otherwise <file_without_extension><extension> in the directory output_string, or next to the input. Creates missing directories.
+*/
+std::string resolve_output_path(const std::string& input_directory, 
+    const std::string& file_without_extension, 
+    const std::string& extension, 
+    const std::string& output_string);
+
 void write_to_file(const std::ostringstream& ostream, 
     std::string output_file_path, 
     const std::string& input_directory, 
@@ -38,15 +51,63 @@ vec<r2degree> get_grid_diagonal(pair<r2degree> bounds, int grid_length);
 r2degree get_grid_step(const r2degree& lower_bound, const r2degree& upper_bound,
     const int& grid_length_x, const int& grid_length_y);
 
+/**
+* @brief x-coordinates of the grid points of every row of the dynamic grid, accumulated exactly as the sweep moves along a row.
+*/
+vec<double> grid_row_coordinates(const r2degree& lower_bound, const r2degree& grid_step, const int& grid_length_x);
+
+
+/**
+* @brief Writes the line "HNF", the size of the grid and its bounds, which start a .sky file.
+*/
+template<typename Outputstream>
+void write_grid_header(Outputstream& ostream, int grid_length_x, int grid_length_y,
+    const r2degree& lower_bound, const r2degree& upper_bound, const r2degree& grid_step){
+    ostream << "HNF" << "\n";
+    ostream << grid_length_x << "," << grid_length_y << "\n";
+    ostream  << lower_bound << "," << upper_bound << "," << grid_step << "\n";
+}
+
+/**
+* @brief Passes the grid to a binary, dictionary or HDF5 writer directly, without formatting it as text.
+*/
+inline void write_grid_header(Sky_cell_sink& sink, int grid_length_x, int grid_length_y,
+    const r2degree& lower_bound, const r2degree& upper_bound, const r2degree& grid_step){
+    sink.header(grid_length_x, grid_length_y, lower_bound, upper_bound, grid_step);
+}
+
+/**
+* @brief Writes the line "G,i,j, (x, y)" which starts the factors of the grid point (i, j).
+*/
+template<typename Outputstream>
+void write_grid_point(Outputstream& ostream, int i, int j, const r2degree& grid_point){
+    ostream << "G," << i << "," << j << ", " << grid_point << "\n";
+}
+
+inline void write_grid_point(Sky_cell_sink& sink, int i, int j, const r2degree& grid_point){
+    sink.cell(i, j, grid_point.first, grid_point.second);
+}
+
+/**
+* @brief Writes an interval of the HN filtration as its slope, followed by the degrees of its relations.
+*/
+template<typename Outputstream>
+void write_interval(Outputstream& ostream, double slope, const vec<r2degree>& relations){
+    ostream << slope;
+    for(const r2degree& d : relations){
+        ostream << "," << "(" << d.first << ";" << d.second << ")";
+    }
+    ostream << "\n";
+}
+
+inline void write_interval(Sky_cell_sink& sink, double slope, const vec<r2degree>& relations){
+    sink.factor(slope, relations);
+}
 
 template< typename Outputstream>
 void to_stream(Outputstream& ostream, Uni_B1& scss){
     if(scss.d1.get_num_rows() == 1){
-        ostream << scss.slope_value;
-        for(r2degree d : scss.d1.col_degrees){
-            ostream << "," << "(" << d.first << ";" << d.second << ")";
-        }
-        ostream << std::endl;
+        write_interval(ostream, scss.slope_value, scss.d1.col_degrees);
     } else {
         std::cerr << "  Passing a submodule of dimension " << scss.d1.get_num_rows() << std::endl;
         std::cerr << "  this should not happen anymore." << std::endl;
@@ -66,20 +127,43 @@ void show_progress_bar(int& i, int& total, std::string& name);
 * @brief this struct stores the local data of an indecomposable X for a whole row of its grid cells.
 * for each cell in position i, with corner alpha, 
 * indecomposable_summands[i] stores the indecomposable summands of \langle X_\alpha \rangle
-* Slope_subdivisions[i] stores the slope subdivisions of those summands of dimension > 1.
+* subdivisions[i] stores the slope subdivisions of those summands of dimension > 1, if slope subdivisions are enabled.
+* The cells of a row are only decomposed once the sweep asks for them, see compute_cell.
 * 
 * //TO-DO: Probably these should be lists, not vectors.
 */
 struct Dynamic_HNF {
     vec<vec<Uni_B1>> indecomposable_summands;
+    // filtrations[x][s] is the last HN filtration computed for indecomposable_summands[x][s] in this row of local cells.
+    vec<vec<Shiftable_filtration>> filtrations;
+    // subdivisions[x][s] is the slope subdivision of indecomposable_summands[x][s] over its local cell, or nullptr.
+    vec<vec<std::shared_ptr<const Slope_subdivision>>> subdivisions;
     vec<int> grid_ind_dimensions;
+    // computed[x] is true once the cell x of the current row has been decomposed.
+    vec<bool> computed;
+    // The cell decomposed last in the current row, its chains seed the filtrations of the next cell.
+    int last_computed = -1;
+    int row_index = -1;
+    double y_next;
+    pair<r2degree> bounds;
 
     Dynamic_HNF();
+    /**
+     * @brief Starts the row y_index of local cells. No cell is decomposed yet.
+     */
     void compute_HNF_row(aida::AIDA_functor& decomposer,
         R2Mat& M,
         int& y_index,
-        pair<r2degree> slope_bounds,
-        const vec<vec<vec<SparseMatrix<int>>>>& subspaces);
+        pair<r2degree> slope_bounds);
+    /**
+     * @brief Decomposes the cell x_index of the current row, unless this has been done already.
+     * Returns true if the cell was decomposed by this call.
+     */
+    bool compute_cell(aida::AIDA_functor& decomposer, R2Mat& M, int x_index);
+    /**
+     * @brief Decomposes all cells of the current row which contain one of the sorted x-coordinates xs.
+     */
+    void compute_cells_at(aida::AIDA_functor& decomposer, R2Mat& M, const vec<double>& xs);
 };
 
 template <typename Container>
@@ -110,105 +194,24 @@ std::tuple<r2degree, r2degree, r2degree, pair<r2degree>> compute_bounds_and_grid
     return {lower_bound, upper_bound, grid_step, slope_bounds};
 };
 
-template<typename Container>
-void update_HNF_rows_at_y_level(
-    r2degree current_grid_degree,
-    Container& indecomps,
-    vec<pair<int>>& grid_locations,
-    vec<Dynamic_HNF>& local_grid_row_data,
-    aida::AIDA_functor& decomposer,
-    const pair<r2degree>& slope_bounds,
-    const vec<vec<vec<SparseMatrix<int>>>>& subspaces) {
-
-    int k = -1;
-    for(R2Mat& M : indecomps){
-        k++;
-        bool recompute = false;
-        grid_locations[k].first = -1; // Reset x-coordinate
-        int& local_y = grid_locations[k].second;
-        if(local_y + 1 == static_cast<int>(M.y_grid.size()) ){
-            // Do nothing for now
-        } else {
-            while(local_y + 1 < static_cast<int>(M.y_grid.size())){
-                if(current_grid_degree.second >= M.y_grid[local_y + 1]){
-                    local_y++;
-                    recompute = true;
-                } else {
-                    break;
-                }
-            }
-        }
-
-        if(recompute){
-            local_grid_row_data[k].compute_HNF_row(decomposer, M, local_y, slope_bounds, subspaces);
-        }
-        if(local_y != -1){
-            assert(current_grid_degree.second >= M.y_grid[local_y] );
-            if( local_y +1 < static_cast<int>(M.y_grid.size())){
-                assert(current_grid_degree.second < M.y_grid[local_y + 1]);
-            } 
-        }
-    }
-}
-
-template< typename Container>
-void update_grid_locations_x(
-    r2degree current_grid_degree,
-    Container& indecomps,
-    vec<pair<int>>& grid_locations){
+/**
+* @brief Moves local_y to the row of the local grid of M which contains current_grid_degree. Returns true if it moved.
+*/
+bool advance_local_row(const r2degree& current_grid_degree, const R2Mat& M, int& local_y);
 
-    int k = -1;
-    for(R2Mat& M : indecomps){
-        k++;
-        int& local_x = grid_locations[k].first;
-        
-        if(local_x + 1 == static_cast<int>(M.x_grid.size()) ){
-            
-        } else {
-            if(false){
-                std::cout << std::setprecision(12);
-                std::cout << "  Updating x grid locations at grid degree " << current_grid_degree << std::endl;
-                std::cout << "  local_x: " << local_x << std::endl;
-                std::cout << "  M.x_grid for the next value: " << M.x_grid[local_x + 1] << std::endl;
-                std::cout << std::endl;
-                if(local_x + 1 < static_cast<int>(M.x_grid.size()) ){
-                    std::cout << " Not at end yet. " << std::endl;
-                    auto B_induced = M.submodule_generated_at(current_grid_degree);
-                    std::cout << B_induced.get_num_rows() << " rows in the induced submodule at the current grid degree." << std::endl;
-                    if(B_induced.get_num_rows() != 0){
-                        std::cout << "  We're not in the local grid yet, but there is already a non-trivial submodule induced at the current grid degree:" << current_grid_degree << std::endl;
-                        std::cout << "  The indecomposable is at position: " << k << " and has presentation " << std::endl;
-                        M.print_graded();
-                        std::cout << "  The induced submodule has presentation " << std::endl;
-                        B_induced.print_graded();
-                        if(current_grid_degree.first >= M.x_grid[local_x + 1]){
-                            std::cout << "moving forward as planned.   " << std::endl;
-                        } else {
-                            std::cout << "M_xgrid[local_x + 1] is " << M.x_grid[local_x + 1] << std::endl;
-                            std::cout << "  But the current grid degree is smaller than the next x grid point, so we should not move forward yet." << std::endl;
-                            std::cout << "  This should not happen, check the grid computation." << std::endl;
-                        }
+void update_HNF_row_of_summand(
+    const r2degree& current_grid_degree,
+    R2Mat& M,
+    pair<int>& grid_location,
+    Dynamic_HNF& local_row_data,
+    aida::AIDA_functor& decomposer,
+    const pair<r2degree>& slope_bounds);
 
-                    }
-                    
-                }
-            }
-            while(local_x + 1 < static_cast<int>(M.x_grid.size()) ){
-                if(current_grid_degree.first >= M.x_grid[local_x + 1]){
-                    local_x++;
-                } else {
-                    break;
-                }
-            }
-        }
-        if(local_x != -1){
-            assert(current_grid_degree.first >= M.x_grid[local_x]);
-            if( local_x + 1 < static_cast<int>(M.x_grid.size()) ){
-                assert(current_grid_degree.first < M.x_grid[local_x + 1]);
-            } 
-        }
-    }
-};
+void update_grid_location_x_of_summand(
+    const r2degree& current_grid_degree,
+    R2Mat& M,
+    int& local_x,
+    const int k = -1);
 
 template<typename Outputstream>
 void write_grid_metadata(Outputstream& ostream,
@@ -219,9 +222,7 @@ void write_grid_metadata(Outputstream& ostream,
     const pair<r2degree>& slope_bounds,
     bool show_info = false) {
     
-    ostream << "HNF" << std::endl;
-    ostream << grid_length_x << "," << grid_length_y << std::endl;
-    ostream  << lower_bound << "," << upper_bound << "," << grid_step << std::endl;
+    write_grid_header(ostream, grid_length_x, grid_length_y, lower_bound, upper_bound, grid_step);
     
     // Since a lot of applications will create unbounded modules, we need to set a bound where to cut off
     // OR use a measure where the dimension function is still integrable
@@ -247,169 +248,48 @@ void compare_slopes_test(
     const vec<HN_factors>& test_factors,
     int i, int j, int k);
 
-template <typename Container>
-void process_grid_cell(
-    int i, int j,
-    r2degree current_grid_degree,
-    Container& indecomps,
-    vec<pair<int>>& grid_locations,
-    vec<Dynamic_HNF>& local_grid_row_data,
+/**
+* @brief Appends the HN filtrations of the summands of \langle M_alpha \rangle at the current grid point alpha 
+* to composition_factors, one (sorted) HN_factors per local indecomposable summand.
+* k is the position of M in the list of indecomposables and only used for debugging output.
+*/
+void process_summand_at_grid_cell(
+    int i, int j, int k,
+    const r2degree& current_grid_degree,
+    R2Mat& M,
+    const pair<int>& grid_location,
+    Dynamic_HNF& local_row_data,
     vec<HN_factors>& composition_factors,
     vec<int>& grid_ind_dimensions,
-    vec<int>& all_scss_dimensions,
-    vec<vec<vec<SparseMatrix<int>>>>& subspaces,
     const pair<r2degree>& slope_bounds,
-    aida::AIDA_functor& decomposer,
-    const bool restrict_dim = true) {
-    
-    bool test = false;
-    
-    bool track= false;
-    int k = -1;
-    for(auto & M : indecomps){
-        vec<HN_factors> test_factors = vec<HN_factors>();
-        vec<HN_factors> copy_factors =  vec<HN_factors>();
-        k++;
-        auto& local_grid_index = grid_locations[k];
-        auto& local_x = local_grid_index.first;
-        r2degree local_grid_degree;
-
-
-        if(local_x == -1 || local_grid_index.second == -1){
-            if(track){
-                std::cout << " tracking at grid point " << current_grid_degree << std::endl;
-                auto B_induced = M.submodule_generated_at(current_grid_degree);
-                if(B_induced.get_num_rows() != 0){
-                    std::cout << "  We're not in the local grid yet, but there is already a non-trivial submodule induced at the current grid degree:" << current_grid_degree << std::endl;
-                    std::cout << "  The indecomposable is at position: " << k << " and has presentation " << std::endl;
-                    M.print_graded();
-                    std::cout << "  The induced submodule has presentation " << std::endl;
-                    B_induced.print_graded();
-                }
-            }
-            // We're not in the local grid yet, so can skip this summand.
-            continue;
-        } else {
-            local_grid_degree = std::make_pair(M.x_grid[local_grid_index.first], M.y_grid[local_grid_index.second]);
-        }
+    aida::AIDA_functor& decomposer);
 
-        
-        
-        Dynamic_HNF& local_dhnf =  local_grid_row_data[k];
-        auto& local_summands = local_dhnf.indecomposable_summands[local_x];
-
-        
-        if(test){
-            auto B_induced = M.submodule_generated_at(current_grid_degree);
-            if(B_induced.get_num_rows() != 0){
-                Block_list sub_B_list;
-                B_induced.compute_col_batches();
-                decomposer(B_induced, sub_B_list);
-                assert(local_summands.size() == sub_B_list.size());
-                int k = 0;
-                for(auto& sub_B : sub_B_list){
-                    if (sub_B.get_num_rows() > subspaces.size()) {
-                        if(restrict_dim){
-                            fill_up_grassmannians(subspaces, sub_B.get_num_rows(), 2);
-                        } else {
-                            fill_up_seperated_grassmannians(subspaces, sub_B.get_num_rows());
-                        }
-                    }
-                    k++;
-                }
-                test_factors = skyscraper_invariant_sum(sub_B_list, subspaces, slope_bounds);
-            } else {
-                assert(local_summands.size() == 0);
-            }
-        }
-        
-        for( Uni_B1& summand : local_summands){
-            double area = static_cast<double>(1)/summand.slope_value;
-            auto shifted_summand = summand;
-            r2degree verschiebung = current_grid_degree - local_grid_degree;
-            if( shifted_summand.d1.get_num_rows() == 0){
-                std::cout << " Empty summands should have been filtered out." << std::endl;
-                assert(false);
-            } else if(shifted_summand.d1.get_num_rows() == 1){
-                double test_slope1 = shifted_summand.slope_value;
-                double slope = shifted_summand.evaluate_slope_polynomial(verschiebung, slope_bounds);
-                if( test_slope1 > slope){
-                    std::cout << "  -   Decreasing slope after shifting by Verschiebung: " << test_slope1 << " original vs. now" << slope << std::endl;
-                    std::cout << "original area: " << area << " vs current " << shifted_summand.evaluate_area_polynomial(verschiebung, slope_bounds) << std::endl;
-                    std::cout << "  area polynomial: " << shifted_summand.area_polynomial[0] << "  " << shifted_summand.area_polynomial[1] << "  " << shifted_summand.area_polynomial[2]  << std::endl;
-                    std::cout << "  Current grid degree: " << current_grid_degree << std::endl;
-                    std::cout << "  Local grid degree: " << local_grid_degree << std::endl;
-                    std::cout << "  i: " << i << ", j: " << j << ", k: " << k << std::endl;
-                    std::cout << "  Verschiebung: " << verschiebung << std::endl;
-                    std::cout << "  Slope bounds: " << slope_bounds.first << " " << slope_bounds.second << std::endl;
-                    std::cout << "  Module: " << std::endl;
-                    shifted_summand.d1.print_graded();
-                    std::cout << "  range_area " << (slope_bounds.second.first - slope_bounds.first.first) * (slope_bounds.second.second - slope_bounds.first.second) << std::endl;
-                    assert(false);
-                }
-                if(test){
-                    double area = shifted_summand.evaluate_area_polynomial(verschiebung, slope_bounds);
-                    R2Mat test_cutoff = shifted_summand.d1.submodule_generated_at(current_grid_degree);
-                    if(test_cutoff.get_num_rows() != 0){
-                        Uni_B1 test_summand(test_cutoff);
-                        // double test_slope = test_summand.slope(slope_bounds);
-                        double test_area = test_summand.area(slope_bounds);
-                        if(essentially_equal(area, test_area, 1e-7, 1e-9) == false){
-                            std::cout << std::fixed << std::setprecision(12);
-                            std::cout << "  Area mismatch at direct cutting off: " << area << " vs. " << test_area << std::endl;
-                            std::cout << "  Difference: " << area - test_area << std::endl;
-                            std::cout << "  Current grid degree: " << current_grid_degree << std::endl;
-                            std::cout << "  Local grid degree: " << local_grid_degree << std::endl;
-                            std::cout << "  i: " << i << ", j: " << j << ", k: " << k << std::endl;
-                            std::cout << "  Summand: " << std::endl;
-                            shifted_summand.d1.print_graded();
-                            std::cout << "  area polynomial: " << 
-                                shifted_summand.area_polynomial[0] << "  " << shifted_summand.area_polynomial[1] << "  " << 
-                                shifted_summand.area_polynomial[2]  << std::endl;
-                            std::cout << "  Verschiebung: " << verschiebung << std::endl;
-                            std::cout << "  Slope bounds: " << slope_bounds.first << " " << slope_bounds.second << std::endl;
-                            auto normalisation = slope_bounds.second - slope_bounds.first;
-                            std::cout << "  Normalisation area: " << normalisation.first * normalisation.second << std::endl;
-                            std::cout << "  Cut off summand: " << std::endl;
-                            test_summand.d1.print_graded();
-                            assert(false);
-                        }
-                    }
-                }
-                // TO-DO: summand is the original local summand, we need to cut it off at the current grid degree,
-                // Even if the slope is already correctly computed by the polynomial.
-                shifted_summand.d1.set_all_generator_degrees(current_grid_degree);
-                shifted_summand.d1.column_reduction_graded();
-                shifted_summand.slope_value = slope;
-                HN_factors singleton = HN_factors();
-                singleton.emplace_back(std::move(shifted_summand));
-                composition_factors.emplace_back(singleton);
-                if(test){
-                    copy_factors.emplace_back(singleton);
-                }
-                grid_ind_dimensions.push_back(1);
-            } else {
-                if (shifted_summand.d1.get_num_rows() > subspaces.size()) {
-                    fill_up_seperated_grassmannians(subspaces, shifted_summand.d1.get_num_rows());
-                }
-                grid_ind_dimensions.push_back(shifted_summand.d1.get_num_rows());
-                auto cut_off = shifted_summand.d1;
-                cut_off.set_all_generator_degrees(current_grid_degree);
-                if(test){
-                    skyscraper_invariant(cut_off, copy_factors, subspaces, slope_bounds);
-                }
-                skyscraper_invariant(cut_off, composition_factors, subspaces, slope_bounds);
-            }
-            
-            
-        }
-        if(test){
-            compare_slopes_test(current_grid_degree, local_grid_degree, 
-                    copy_factors, test_factors, i, j, k);
-        }
-    }
+/**
+* @brief The last submodule one indecomposable induced in the fixed-grid sweep, with its decomposition and HN filtrations.
+* Moving to the next grid point often only moves the generators, then the decomposition is reused.
+*/
+struct Induced_decomposition {
+    bool valid = false;
+    // Number of rows, relation degrees and relations of the induced submodule identify it up to its generator degree.
+    R2Mat relations;
+    aida::Block_list blocks;
+    // filtrations[b] is the last HN filtration of the b-th block, reused after a shift or seeding the next computation.
+    vec<Shiftable_filtration> filtrations;
+    int num_reused = 0;
 };
 
+/**
+* @brief Appends the HN filtrations of the summands of B_induced, which has at least two generators, to composition_factors.
+* If B_induced is uniquely generated and has the same relations as the previous submodule in cache, 
+* the blocks of cache are moved to the new generator degree instead of decomposing B_induced again,
+* and their last HN filtrations are shifted along with them unless Shiftable_filtration::shift has to recompute them.
+*/
+void induced_submodule_factors(R2Mat& B_induced,
+    Induced_decomposition& cache,
+    vec<HN_factors>& composition_factors,
+    vec<int>& grid_ind_dimensions,
+    const pair<r2degree>& slope_bounds,
+    aida::AIDA_functor& decomposer);
 
 template<typename Container, typename Outputstream>
 void process_summands_fixed_grid(aida::AIDA_functor& decomposer, 
@@ -460,6 +340,8 @@ void process_summands_fixed_grid(aida::AIDA_functor& decomposer,
 
     vec<HN_factors> composition_factors;
     composition_factors.reserve(100);
+    // One per indecomposable, carried along the rows of the grid.
+    vec<Induced_decomposition> induced_decompositions(num_of_summands);
 
     r2degree current_grid_degree = lower_bound;
     for(int j = 0; j < grid_length_y; j++){
@@ -467,7 +349,7 @@ void process_summands_fixed_grid(aida::AIDA_functor& decomposer,
         for(int i = 0; i < grid_length_x; i++){ 
       
         composition_factors.clear();
-        ostream << "G," << i << "," << j << ", " << current_grid_degree << "\n";
+        write_grid_point(ostream, i, j, current_grid_degree);
 
         if (progress_bar) {
             int current_index = j * grid_length_x + i;
@@ -507,20 +389,8 @@ void process_summands_fixed_grid(aida::AIDA_functor& decomposer,
             } else if ( B_induced.get_num_rows() == 0){
                 // Do nothing.
             } else {
-                aida::Block_list sub_B_list;
-                B_induced.compute_col_batches();
-                decomposer(B_induced, sub_B_list);
-                int max_dim = 0;
-                for(Block& sub_B : sub_B_list){
-                    if(sub_B.get_num_rows() == 1){
-
-                    } else if(sub_B.get_num_rows() > max_dim){
-                        max_dim = sub_B.get_num_rows();
-                    }
-                    grid_ind_dimensions.push_back(sub_B.get_num_rows());
-                }
-                auto subspaces = sparse_seperated_grassmannians<int>(max_dim);
-                skyscraper_invariant_sum_append(sub_B_list, composition_factors, subspaces, slope_bounds);
+                induced_submodule_factors(B_induced, induced_decompositions[indecomp_index], composition_factors, 
+                    grid_ind_dimensions, slope_bounds, decomposer);
             }
 
             
@@ -555,6 +425,14 @@ void process_summands_fixed_grid(aida::AIDA_functor& decomposer,
       current_grid_degree.second += grid_step.second;
     }
 
+    if(show_info){
+        int num_reused = 0;
+        for(const Induced_decomposition& induced : induced_decompositions){
+            num_reused += induced.num_reused;
+        }
+        std::cout << std::endl << "  Reused " << num_reused << " decompositions of induced submodules from the previous grid point." << std::endl;
+    }
+
     std::cout << std::endl;
     std::cout << "  Tracked the dimensions of " << grid_ind_dimensions.size() << " indecomposable summands." << std::endl;
     
@@ -568,25 +446,322 @@ void process_summands_fixed_grid(aida::AIDA_functor& decomposer,
 
 }
 
-template<typename Container, typename Outputstream>
-void process_summands_smart_grid(aida::AIDA_functor& decomposer, 
-    Outputstream& ostream, 
-    const int& grid_length_x, const int& grid_length_y, 
-    Container& indecomps, const bool restrict_dim = true) {
+/**
+* @brief Structure-of-arrays engine for the summands with a single generator. 
+* Their HN filtration is the summand itself, so along a row of the global grid only the slopes change, 
+* and they are evaluated for the whole row at once instead of going through process_summand_at_grid_cell.
+*/
+struct Interval_row {
+    int grid_length_x = 0;
+    // Interval summands which are nonzero somewhere in the current row, sorted by index.
+    vec<int> summands;
+    // slopes[s*grid_length_x + i] is the slope of summands[s] at the i-th grid point of the row, NaN where it is zero.
+    vec<double> slopes;
+    // The relations written out for summands[s] at the i-th grid point, at the same position.
+    vec<const vec<r2degree>*> relations;
+    // cell_relations[k][x] are the relations of the local summand in the x-th local cell of the current row of the k-th summand,
+    // filled in when the cell is decomposed.
+    vec<vec<vec<r2degree>>> cell_relations;
+
+    /**
+    * @brief Has to be called whenever the local row of the k-th summand has been restarted.
+    */
+    void update_cells(int k, const Dynamic_HNF& local_row_data);
+
+    /**
+    * @brief Decomposes the x-th local cell of the k-th summand if necessary and reduces its relations.
+    */
+    void compute_cell(int k, Dynamic_HNF& local_row_data, R2Mat& M, int x, aida::AIDA_functor& decomposer);
+
+    /**
+    * @brief Stores the relations of the x-th local cell of the k-th summand, which has to be decomposed already.
+    */
+    void reduce_cell(int k, const Dynamic_HNF& local_row_data, int x);
+
+    /**
+    * @brief Evaluates the slopes of all interval summands in active at the grid points (xs[i], y).
+    * Only the local cells which contain one of these grid points are decomposed.
+    */
+    void evaluate_row(const vec<int>& active,
+        const vec<R2Mat*>& all_summands,
+        const vec<pair<int>>& grid_locations,
+        vec<Dynamic_HNF>& local_grid_row_data,
+        const vec<double>& xs,
+        double y,
+        const pair<r2degree>& slope_bounds,
+        aida::AIDA_functor& decomposer);
+};
+
+/**
+* @brief The local rows which start at one row of the global grid, decomposed ahead of the sweep by prefetch_local_rows.
+*/
+struct Prefetched_rows {
+    // Sorted by index, rows[s] is the new local row of summands[s].
+    vec<int> summands;
+    vec<Dynamic_HNF> rows;
+
+    /**
+    * @brief The prefetched local row of the k-th summand, nullptr if its local row does not change here.
+    */
+    Dynamic_HNF* find(int k);
+};
+
+/**
+* @brief The state a sweep over consecutive rows of the global grid carries from one row to the next.
+* A single-threaded sweep owns one of these, a parallel sweep creates one per band of rows.
+*/
+struct Grid_sweep_state {
+    // (coordinate, summand) of the next line of a local grid which the sweep will cross, smallest first.
+    using Crossing = std::pair<double, int>;
+    using Crossing_queue = std::priority_queue<Crossing, vec<Crossing>, std::greater<Crossing>>;
 
+    vec<R2Mat*> summands;
+    // Will store where we are in the local grids:
+    vec<pair<int>> grid_locations;
+    // Will store the decomposed modules generated at the local grid points:
     vec<Dynamic_HNF> local_grid_row_data;
-    vec<vec<vec<SparseMatrix<int>>>> subspaces;
-    if(restrict_dim){
-        subspaces = all_sparse_grassmannians(3,2);
+    // Will store the actual composition factors of the HNF at each grid point.
+    vec<HN_factors> composition_factors;
+    // Only for statistics:
+    vec<int> grid_ind_dimensions;
+    vec<int> all_scss_dimensions;
+
+    // Summands are only visited once the sweep has entered their local grid. 
+    // y_crossings holds every summand whose local grid has a line above the current row,
+    // x_crossings every summand of active_rows with a line right of the current grid point.
+    Crossing_queue y_crossings;
+    Crossing_queue x_crossings;
+    // Summands whose local grid contains the current row and whose local row is not zero, sorted by index.
+    vec<int> active_rows;
+    // Summands whose local grid contains the current grid point, sorted by index.
+    // Intervals are never in here, they are handled by the interval engine.
+    vec<int> active_cells;
+
+    vec<bool> is_interval;
+    Interval_row intervals;
+
+    // Local rows decomposed in advance for the current row of the global grid, nullptr if the sweep decomposes them itself.
+    Prefetched_rows* prefetched = nullptr;
+
+    template<typename Container>
+    Grid_sweep_state(Container& indecomps) {
+        for(R2Mat& M : indecomps){
+            int k = summands.size();
+            summands.push_back(&M);
+            is_interval.push_back(M.get_num_rows() == 1);
+            if(M.get_num_rows() > 0 && !M.x_grid.empty() && !M.y_grid.empty()){
+                y_crossings.push({M.y_grid[0], k});
+            }
+        }
+        grid_locations = vec<pair<int>>(summands.size(), {-1,-1});
+        local_grid_row_data = vec<Dynamic_HNF>(summands.size(), Dynamic_HNF());
+        intervals.cell_relations.resize(summands.size());
+    }
+};
+
+/**
+* @brief Moves to the row of current_grid_degree: recomputes the local rows of the summands which cross a line of their local y-grid,
+* and resets the x-locations of all summands for the new row.
+*/
+void update_HNF_rows_at_y_level(
+    const r2degree& current_grid_degree,
+    Grid_sweep_state& state,
+    aida::AIDA_functor& decomposer,
+    const pair<r2degree>& slope_bounds);
+
+/**
+* @brief Producer of the pipelined sweep. Runs through the rows of the global grid like update_HNF_rows_at_y_level, 
+* decomposes every new local row at the grid points xs and pushes one Prefetched_rows per row of the global grid to queue.
+* Stops early if the queue is closed.
+*/
+void prefetch_local_rows(const vec<R2Mat*>& summands,
+    const int& grid_length_y,
+    const vec<double>& xs,
+    const r2degree& lower_bound,
+    const r2degree& grid_step,
+    const pair<r2degree>& slope_bounds,
+    aida::AIDA_functor& decomposer,
+    Bounded_queue<Prefetched_rows>& queue);
+
+/**
+* @brief Moves the x-locations of the summands which cross a line of their local x-grid before current_grid_degree.
+*/
+void update_grid_locations_x(const r2degree& current_grid_degree, Grid_sweep_state& state);
+
+/**
+* @brief Adds the HN factors at current_grid_degree of every active summand to state.composition_factors, in the order of the summands.
+*/
+void process_grid_cell(
+    int i, int j,
+    const r2degree& current_grid_degree,
+    Grid_sweep_state& state,
+    const pair<r2degree>& slope_bounds,
+    aida::AIDA_functor& decomposer);
+
+/**
+* @brief Options for the sweep over the global grid which do not change the result.
+*/
+struct Sweep_options {
+    // Number of threads for the grid sweep, 1 means the sweep runs on the calling thread.
+    int num_threads = 1;
+    // Run every indecomposable as its own task and merge the factors per grid point, instead of splitting rows.
+    bool per_summand_tasks = false;
+    // Split every row into one task per (indecomposable, local cell) and schedule them by estimated cost.
+    bool cell_tasks = false;
+    // Write the regions of constant HN type of every local cell instead of sampling the grid, see process_summands_regions.
+    bool region_output = false;
+    // Decompose the local rows on a second thread, ahead of the single-threaded sweep.
+    bool pipeline = false;
+};
+
+/**
+* @brief Number of subspaces of F_2^k, i.e. the size of the search space of find_scss_bruteforce.
+*/
+double number_of_subspaces(int k);
+
+/**
+* @brief Estimated cost of computing the HN filtration of all local summands of one local cell at a single grid point.
+*/
+double hnf_cost_estimate(const vec<Uni_B1>& local_summands);
+
+/**
+* @brief The state of the sweep of a single indecomposable over the global grid.
+* Used by the per-summand engine, where each indecomposable is advanced by its own task.
+*/
+struct Summand_sweep {
+    pair<int> grid_location = {-1, -1};
+    Dynamic_HNF local_row_data;
+    vec<int> grid_ind_dimensions;
+};
+
+/**
+* @brief Computes the HN factors of one indecomposable M at all global grid points in the rows [j_begin, j_end).
+* cell_streams[(j-j_begin)*grid_length_x + i] is set to the factors at (i,j), sorted by decreasing slope.
+* sweep has to come from the rows below j_begin (or be fresh).
+*/
+void sweep_summand_over_rows(int k, R2Mat& M, Summand_sweep& sweep,
+    int j_begin, int j_end,
+    const int& grid_length_x,
+    const r2degree& lower_bound,
+    const r2degree& grid_step,
+    const pair<r2degree>& slope_bounds,
+    aida::AIDA_functor& decomposer,
+    vec<HN_factors>& cell_streams);
+
+template<typename Outputstream>
+void write_factor(Outputstream& ostream, Uni_B1& hn_factor, vec<int>& all_scss_dimensions) {
+    int k = hn_factor.d1.get_num_rows();
+    all_scss_dimensions.push_back(k);
+    if(hn_factor.slope_value == INFINITY){
+        std::cout << "  There are unbounded modules in the decomposition." << std::endl;
+        std::cout << "  Consider passing a bound." << std::endl;
+        assert(false);
+    }
+    if(k ==1){
+        to_stream(ostream, hn_factor);
     } else {
-        subspaces = sparse_seperated_grassmannians(3);
+        // Need to split into intervals:
+        auto intervals = split_into_intervals(hn_factor);
+        for(auto& interval : intervals){
+            to_stream(ostream, interval);
+        }
     }
-    int grid_size = grid_length_x * grid_length_y;
+}
+
+template<typename Outputstream>
+void write_filtration(Outputstream& ostream, HN_factors& filtration, vec<int>& all_scss_dimensions) {
+    for(auto& hn_factor : filtration){
+        write_factor(ostream, hn_factor, all_scss_dimensions);
+    }
+}
+
+/**
+* @brief Same as write_filtration, but merges in the interval summands of the i-th grid point of intervals by slope.
+*/
+template<typename Outputstream>
+void write_filtration(Outputstream& ostream, HN_factors& filtration, const Interval_row& intervals, int i, 
+    vec<int>& all_scss_dimensions, vec<int>& grid_ind_dimensions) {
+    vec<std::pair<double, const vec<r2degree>*>> interval_factors;
+    for(size_t s = 0; s < intervals.summands.size(); s++){
+        size_t index = s * intervals.grid_length_x + i;
+        if(!std::isnan(intervals.slopes[index])){
+            interval_factors.emplace_back(intervals.slopes[index], intervals.relations[index]);
+        }
+    }
+    std::stable_sort(interval_factors.begin(), interval_factors.end(), [](const auto& a, const auto& b) {
+        return a.first > b.first;
+    });
+    size_t f = 0;
+    for(const auto& [slope, relations] : interval_factors){
+        while(f < filtration.size() && filtration[f].slope_value >= slope){
+            write_factor(ostream, filtration[f++], all_scss_dimensions);
+        }
+        grid_ind_dimensions.push_back(1);
+        all_scss_dimensions.push_back(1);
+        write_interval(ostream, slope, *relations);
+    }
+    while(f < filtration.size()){
+        write_factor(ostream, filtration[f++], all_scss_dimensions);
+    }
+}
+
+/**
+* @brief Computes and writes the HNF at all grid points of the j-th row of the global grid.
+* The local grid locations in state have to be valid for some row below j (or be reset to -1).
+*/
+template<typename Container, typename Outputstream>
+void process_grid_row(int j,
+    const int& grid_length_x,
+    const r2degree& lower_bound,
+    const r2degree& grid_step,
+    const pair<r2degree>& slope_bounds,
+    Container& indecomps,
+    Grid_sweep_state& state,
+    aida::AIDA_functor& decomposer,
+    Outputstream& ostream,
+    const bool progress_bar = false,
+    int grid_size = 0) {
+
+    r2degree current_grid_degree;
+    current_grid_degree.first = lower_bound.first - grid_step.first*0.999; // Reset x-coordinate for each y-coordinate
+    current_grid_degree.second = lower_bound.second + j*grid_step.second;
+    // First in y direction, we recompute all local decompositions whenever necessary.
+    update_HNF_rows_at_y_level(current_grid_degree, state, decomposer, slope_bounds);
+
+    vec<double> xs = grid_row_coordinates(lower_bound, grid_step, grid_length_x);
+    state.intervals.evaluate_row(state.active_rows, state.summands, state.grid_locations, state.local_grid_row_data, 
+        xs, current_grid_degree.second, slope_bounds, decomposer);
     
-    bool progress_bar = decomposer.config.progress;
+    for(int i = 0; i < grid_length_x; i++){
+        current_grid_degree.first = xs[i];
+        // Then we need to check if we have crossed into a new grid-square in any local grid.    
+        update_grid_locations_x(current_grid_degree, state);
+
+        write_grid_point(ostream, i, j, current_grid_degree);
+        if (progress_bar) {
+            int points_processed = j * grid_length_x + i;
+            std::string name = "Grid point";
+            show_progress_bar(points_processed, grid_size, name);
+        }
+        // Now actually compute the HNF, but use the data previously computed 
+        state.composition_factors.clear();
+        process_grid_cell(i, j, current_grid_degree, state, slope_bounds, decomposer);
+
+        // Need to recalculate the slope values of the actual filtration from the factors.
+        HN_factors filtration = sort_merge(state.composition_factors);
+        write_filtration(ostream, filtration, state.intervals, i, state.all_scss_dimensions, state.grid_ind_dimensions);
+    }
+}
+
+template<typename Container>
+std::tuple<r2degree, r2degree, r2degree, pair<r2degree>> prepare_smart_grid(aida::AIDA_functor& decomposer, 
+    const int& grid_length_x, const int& grid_length_y, 
+    Container& indecomps, bool& progress_bar, bool& show_info) {
+
+    progress_bar = decomposer.config.progress;
     decomposer.config.progress = false;
 
-    bool show_info = decomposer.config.show_info;
+    show_info = decomposer.config.show_info;
     decomposer.config.show_info = false;
 
     decomposer.config.save_base_change = true; // Only for debugging, TO-DO: remove later.
@@ -595,89 +770,490 @@ void process_summands_smart_grid(aida::AIDA_functor& decomposer,
         std::cout << "The first decomposition has " << indecomps.size() 
                   << " indecomposable summands." << std::endl;
     }
-    
-    // Only for statistics:
-    vec<int> all_scss_dimensions;
-    vec<int> grid_ind_dimensions;
     vec<int> first_ind_dimensions;
-
-    auto [lower_bound, upper_bound, grid_step, slope_bounds] = compute_bounds_and_grid(indecomps, first_ind_dimensions, grid_length_x, grid_length_y);
-    write_grid_metadata(ostream, grid_length_x, grid_length_y, lower_bound, upper_bound, grid_step, slope_bounds, show_info);
-
+    auto bounds_and_grid = compute_bounds_and_grid(indecomps, first_ind_dimensions, grid_length_x, grid_length_y);
+    const pair<r2degree>& slope_bounds = std::get<3>(bounds_and_grid);
     for (auto& B : indecomps) {
         // Now cutting the module off at the slope bound, so that we do not have to deal with unbounded modules anymore,
         //  which has caused bugs in the past.
         B.bound_support(slope_bounds.second);
     }
+    return bounds_and_grid;
+}
 
+inline void print_sweep_statistics(const vec<int>& grid_ind_dimensions, const vec<int>& all_scss_dimensions) {
+    std::cout << std::endl;
+    std::cout << "  Tracked the dimensions of " << grid_ind_dimensions.size() << " indecomposable summands." << std::endl;
+    std::cout << "  The dimensions of indecomposable summands at the grid points are distributed as:" << std::endl;
+    calculate_stats(grid_ind_dimensions);
+    std::cout << "  The dimensions of the composition factors at the grid points are distributed as:" << std::endl;
+    calculate_stats(all_scss_dimensions);
+}
 
-    // Will store the actual composition factors of the HNF at each grid point.
-    vec<HN_factors> composition_factors;
+/**
+* @brief Sweeps the global grid row by row on the calling thread. 
+* With pipeline, the local rows are decomposed by prefetch_local_rows on a second thread, a few rows ahead of the sweep.
+*/
+template<typename Container, typename Outputstream>
+void process_summands_smart_grid(aida::AIDA_functor& decomposer, 
+    Outputstream& ostream, 
+    const int& grid_length_x, const int& grid_length_y, 
+    Container& indecomps, const bool pipeline = false) {
 
-    composition_factors.reserve(100); //TO-DO: replace by thickness of module.
+    int grid_size = grid_length_x * grid_length_y;
+    bool progress_bar, show_info;
 
-    // Will store where we are in the local grids:
-    vec<pair<int>> grid_locations = vec<pair<int>>(indecomps.size(), {-1,-1});
-    // Will store the decomposed modules generated at the local grid points:
-    local_grid_row_data = vec<Dynamic_HNF>(indecomps.size(), Dynamic_HNF());
-    
-    // Start one step too early for better indexing:
-    r2degree current_grid_degree = lower_bound - grid_step;
-
-    for(int j = 0; j < grid_length_y; j++){ 
-        current_grid_degree.first = lower_bound.first - grid_step.first*0.999; // Reset x-coordinate for each y-coordinate
-        current_grid_degree.second = lower_bound.second + j*grid_step.second;
-        // First in y direction, we recompute all local decompositions whenever necessary.
-        update_HNF_rows_at_y_level(current_grid_degree, indecomps, grid_locations, local_grid_row_data, decomposer, slope_bounds, subspaces);
-        
+    auto [lower_bound, upper_bound, grid_step, slope_bounds] = prepare_smart_grid(decomposer, grid_length_x, grid_length_y, indecomps, progress_bar, show_info);
+    write_grid_metadata(ostream, grid_length_x, grid_length_y, lower_bound, upper_bound, grid_step, slope_bounds, show_info);
+
+    Grid_sweep_state state(indecomps);
+    state.composition_factors.reserve(100); //TO-DO: replace by thickness of module.
+
+    if(!pipeline){
+        for(int j = 0; j < grid_length_y; j++){ 
+            process_grid_row(j, grid_length_x, lower_bound, grid_step, slope_bounds, indecomps, state, 
+                decomposer, ostream, progress_bar, grid_size);
+        }
+    } else {
+        // AIDA runs a few rows ahead on its own thread, the sweep only computes HN filtrations.
+        const size_t pipeline_depth = 4;
+        Bounded_queue<Prefetched_rows> queue(pipeline_depth);
+        aida::AIDA_functor prefetch_decomposer = decomposer;
+        vec<double> xs = grid_row_coordinates(lower_bound, grid_step, grid_length_x);
+        std::exception_ptr prefetch_error;
+        std::thread producer([&]() {
+            try {
+                prefetch_local_rows(state.summands, grid_length_y, xs, lower_bound, grid_step, slope_bounds, prefetch_decomposer, queue);
+            } catch (...) {
+                prefetch_error = std::current_exception();
+            }
+            queue.close();
+        });
+        try {
+            Prefetched_rows rows;
+            for(int j = 0; j < grid_length_y && queue.pop(rows); j++){
+                state.prefetched = &rows;
+                process_grid_row(j, grid_length_x, lower_bound, grid_step, slope_bounds, indecomps, state, 
+                    decomposer, ostream, progress_bar, grid_size);
+            }
+            state.prefetched = nullptr;
+        } catch (...) {
+            queue.close();
+            producer.join();
+            throw;
+        }
+        producer.join();
+        if(prefetch_error){
+            std::rethrow_exception(prefetch_error);
+        }
+    }
+
+    print_sweep_statistics(state.grid_ind_dimensions, state.all_scss_dimensions);
+}
+
+/**
+* @brief The output of one band of the parallel sweep, kept until the bands above it are written.
+*/
+template<typename Outputstream>
+struct Band_output {
+    std::ostringstream buffer;
+
+    explicit Band_output(const Outputstream& ostream) { buffer.copyfmt(ostream); }
+    std::ostream& stream() { return buffer; }
+    void write_to(Outputstream& ostream) const { ostream << buffer.str(); }
+};
+
+template<>
+struct Band_output<Sky_cell_sink> {
+    Sky_cell_buffer buffer;
+
+    explicit Band_output(const Sky_cell_sink&) {}
+    Sky_cell_sink& stream() { return buffer; }
+    void write_to(Sky_cell_sink& sink) const { buffer.replay(sink); }
+};
+
+/**
+* @brief Same output as process_summands_smart_grid, but bands of consecutive rows are computed on a thread pool.
+* Every worker has its own AIDA_functor, every band its own local grid state,
+* which is rebuilt from the bottom of the local grids at the first row of the band.
+* The summands themselves are only read. Bands are written to ostream in grid order.
+*/
+template<typename Container, typename Outputstream>
+void process_summands_smart_grid_parallel(aida::AIDA_functor& decomposer, 
+    Outputstream& ostream, 
+    const int& grid_length_x, const int& grid_length_y, 
+    Container& indecomps, const int num_threads) {
+
+    int grid_size = grid_length_x * grid_length_y;
+    bool progress_bar, show_info;
+
+    // Plain variables instead of a structured binding, because the tasks below capture them.
+    r2degree lower_bound, upper_bound, grid_step;
+    pair<r2degree> slope_bounds;
+    std::tie(lower_bound, upper_bound, grid_step, slope_bounds) = prepare_smart_grid(decomposer, grid_length_x, grid_length_y, indecomps, progress_bar, show_info);
+    write_grid_metadata(ostream, grid_length_x, grid_length_y, lower_bound, upper_bound, grid_step, slope_bounds, show_info);
+
+    // Every band pays for one full recomputation of the local rows, so do not make them too thin.
+    const int bands_per_thread = 4;
+    int band_height = std::max(1, grid_length_y / (bands_per_thread * num_threads));
+    int num_bands = (grid_length_y + band_height - 1) / band_height;
+
+    vec<aida::AIDA_functor> worker_decomposers(num_threads, decomposer);
+
+    struct Band_result {
+        Band_output<Outputstream> output;
+        vec<int> grid_ind_dimensions;
+        vec<int> all_scss_dimensions;
+    };
+
+    Thread_pool pool(num_threads);
+    vec<std::future<Band_result>> bands;
+    bands.reserve(num_bands);
+    for(int b = 0; b < num_bands; b++){
+        int j_begin = b * band_height;
+        int j_end = std::min(grid_length_y, j_begin + band_height);
+        bands.emplace_back(pool.submit([&, j_begin, j_end]() {
+            int worker = Thread_pool::worker_index();
+            Grid_sweep_state state(indecomps);
+            state.composition_factors.reserve(100);
+            Band_output<Outputstream> band_output(ostream);
+            for(int j = j_begin; j < j_end; j++){
+                process_grid_row(j, grid_length_x, lower_bound, grid_step, slope_bounds, indecomps, state, 
+                    worker_decomposers[worker], band_output.stream());
+            }
+            return Band_result{std::move(band_output), std::move(state.grid_ind_dimensions), std::move(state.all_scss_dimensions)};
+        }));
+    }
+
+    vec<int> all_scss_dimensions;
+    vec<int> grid_ind_dimensions;
+    for(int b = 0; b < num_bands; b++){
+        Band_result result = bands[b].get();
+        result.output.write_to(ostream);
+        grid_ind_dimensions.insert(grid_ind_dimensions.end(), result.grid_ind_dimensions.begin(), result.grid_ind_dimensions.end());
+        all_scss_dimensions.insert(all_scss_dimensions.end(), result.all_scss_dimensions.begin(), result.all_scss_dimensions.end());
+        if (progress_bar) {
+            int points_processed = std::min(grid_length_y, (b+1) * band_height) * grid_length_x - 1;
+            std::string name = "Grid point";
+            show_progress_bar(points_processed, grid_size, name);
+        }
+    }
+
+    print_sweep_statistics(grid_ind_dimensions, all_scss_dimensions);
+}
+
+/**
+* @brief Same output as process_summands_smart_grid up to the order of factors with equal slope,
+* but every indecomposable sweeps the grid as its own task on a thread pool.
+* The grid is processed in bands of rows: in each band every summand produces one sorted stream of factors per grid point,
+* and these streams are k-way merged per grid point. This scales with the number of summands instead of the size of the grid.
+*/
+template<typename Container, typename Outputstream>
+void process_summands_per_summand(aida::AIDA_functor& decomposer, 
+    Outputstream& ostream, 
+    const int& grid_length_x, const int& grid_length_y, 
+    Container& indecomps, const int num_threads) {
+
+    int grid_size = grid_length_x * grid_length_y;
+    bool progress_bar, show_info;
+
+    r2degree lower_bound, upper_bound, grid_step;
+    pair<r2degree> slope_bounds;
+    std::tie(lower_bound, upper_bound, grid_step, slope_bounds) = prepare_smart_grid(decomposer, grid_length_x, grid_length_y, indecomps, progress_bar, show_info);
+    write_grid_metadata(ostream, grid_length_x, grid_length_y, lower_bound, upper_bound, grid_step, slope_bounds, show_info);
+
+    vec<R2Mat*> summands;
+    for(R2Mat& M : indecomps){
+        summands.push_back(&M);
+    }
+    int num_summands = summands.size();
+    vec<Summand_sweep> sweeps(num_summands);
+
+    vec<aida::AIDA_functor> worker_decomposers(num_threads, decomposer);
+
+    // Bound the number of factor streams which are alive at the same time.
+    const int max_cell_streams = 1 << 20;
+    int band_height = std::clamp(max_cell_streams / (grid_length_x * std::max(1, num_summands)), 1, grid_length_y);
+
+    // summand_streams[k][c] are the factors of the k-th summand at the c-th grid point of the current band.
+    vec<vec<HN_factors>> summand_streams(num_summands);
+    vec<int> all_scss_dimensions;
+
+    Thread_pool pool(num_threads);
+    for(int j_begin = 0; j_begin < grid_length_y; j_begin += band_height){
+        int j_end = std::min(grid_length_y, j_begin + band_height);
+        vec<std::future<void>> tasks;
+        tasks.reserve(num_summands);
+        for(int k = 0; k < num_summands; k++){
+            tasks.emplace_back(pool.submit([&, k, j_begin, j_end]() {
+                int worker = Thread_pool::worker_index();
+                sweep_summand_over_rows(k, *summands[k], sweeps[k], j_begin, j_end, grid_length_x, lower_bound, grid_step, 
+                    slope_bounds, worker_decomposers[worker], summand_streams[k]);
+            }));
+        }
+        for(auto& task : tasks){
+            task.get();
+        }
+
+        for(int j = j_begin; j < j_end; j++){
+            r2degree current_grid_degree;
+            current_grid_degree.first = lower_bound.first - grid_step.first*0.999;
+            current_grid_degree.second = lower_bound.second + j*grid_step.second;
+            for(int i = 0; i < grid_length_x; i++){
+                current_grid_degree.first += grid_step.first;
+                write_grid_point(ostream, i, j, current_grid_degree);
+                int cell = (j - j_begin) * grid_length_x + i;
+                vec<HN_factors> cell_streams;
+                for(int k = 0; k < num_summands; k++){
+                    if(!summand_streams[k][cell].empty()){
+                        cell_streams.emplace_back(std::move(summand_streams[k][cell]));
+                    }
+                }
+                HN_factors filtration = k_merge(cell_streams);
+                write_filtration(ostream, filtration, all_scss_dimensions);
+            }
+        }
+        if (progress_bar) {
+            int points_processed = j_end * grid_length_x - 1;
+            std::string name = "Grid point";
+            show_progress_bar(points_processed, grid_size, name);
+        }
+    }
+
+    vec<int> grid_ind_dimensions;
+    for(auto& sweep : sweeps){
+        grid_ind_dimensions.insert(grid_ind_dimensions.end(), sweep.grid_ind_dimensions.begin(), sweep.grid_ind_dimensions.end());
+    }
+    print_sweep_statistics(grid_ind_dimensions, all_scss_dimensions);
+}
+
+/**
+* @brief Same output as process_summands_per_summand, but each row is split into fine-grained tasks,
+* one per (indecomposable, local grid cell), which run on a work-stealing pool.
+* For each row, first the local rows of the indecomposables which have entered a new local row are decomposed,
+* then the HN filtrations of all local cells are computed, the most expensive cells first,
+* with the cost estimated from the dimension and the number of relations of the local summands.
+*/
+template<typename Container, typename Outputstream>
+void process_summands_cell_tasks(aida::AIDA_functor& decomposer, 
+    Outputstream& ostream, 
+    const int& grid_length_x, const int& grid_length_y, 
+    Container& indecomps, const int num_threads) {
+
+    int grid_size = grid_length_x * grid_length_y;
+    bool progress_bar, show_info;
+
+    r2degree lower_bound, upper_bound, grid_step;
+    pair<r2degree> slope_bounds;
+    std::tie(lower_bound, upper_bound, grid_step, slope_bounds) = prepare_smart_grid(decomposer, grid_length_x, grid_length_y, indecomps, progress_bar, show_info);
+    write_grid_metadata(ostream, grid_length_x, grid_length_y, lower_bound, upper_bound, grid_step, slope_bounds, show_info);
+
+    vec<R2Mat*> summands;
+    for(R2Mat& M : indecomps){
+        summands.push_back(&M);
+    }
+    int num_summands = summands.size();
+    vec<Summand_sweep> sweeps(num_summands);
+
+    vec<aida::AIDA_functor> worker_decomposers(num_threads, decomposer);
+    vec<vec<int>> worker_dimensions(num_threads);
+
+    // summand_streams[k][i] are the factors of the k-th summand at the i-th grid point of the current row.
+    vec<vec<HN_factors>> summand_streams(num_summands, vec<HN_factors>(grid_length_x));
+    vec<int> all_scss_dimensions;
+    vec<Prioritised_task> tasks;
+
+    // The x-coordinates of the grid points are the same in every row. The grouping into cells, the tasks and the writer
+    // all take them from here, they are the same values the serial sweep accumulates.
+    vec<double> xs = grid_row_coordinates(lower_bound, grid_step, grid_length_x);
+
+    Work_stealing_pool pool(num_threads);
+    for(int j = 0; j < grid_length_y; j++){
+        r2degree row_start;
+        row_start.first = lower_bound.first - grid_step.first*0.999;
+        row_start.second = lower_bound.second + j*grid_step.second;
+
+        // First the local rows, the cost of AIDA grows with the size of the local row.
+        // Only the cells which contain a grid point are decomposed, so that the cell tasks below only read the row.
+        for(int k = 0; k < num_summands; k++){
+            R2Mat& M = *summands[k];
+            double cost = static_cast<double>(M.get_num_cols()) * M.x_grid.size();
+            tasks.push_back({cost, [&, k](int worker) {
+                Summand_sweep& sweep = sweeps[k];
+                update_HNF_row_of_summand(row_start, *summands[k], sweep.grid_location, sweep.local_row_data, 
+                    worker_decomposers[worker], slope_bounds);
+                if(sweep.grid_location.second != -1){
+                    sweep.local_row_data.compute_cells_at(worker_decomposers[worker], *summands[k], xs);
+                }
+            }});
+        }
+        pool.run_batch(tasks);
+
+        // Then group the grid points of the row by the local cell they fall into.
+        for(int k = 0; k < num_summands; k++){
+            R2Mat& M = *summands[k];
+            Summand_sweep& sweep = sweeps[k];
+            r2degree current_grid_degree = row_start;
+            int cell_begin = 0;
+            int cell_x = -1;
+            auto submit_cell = [&](int i_begin, int i_end, int local_x) {
+                if(local_x == -1 || sweep.grid_location.second == -1 || i_begin == i_end){
+                    return;
+                }
+                const vec<Uni_B1>& local_summands = sweep.local_row_data.indecomposable_summands[local_x];
+                if(local_summands.empty()){
+                    return;
+                }
+                double cost = hnf_cost_estimate(local_summands) * (i_end - i_begin);
+                tasks.push_back({cost, [&, k, i_begin, i_end, local_x, row_start](int worker) {
+                    pair<int> grid_location = {local_x, sweeps[k].grid_location.second};
+                    r2degree point = row_start;
+                    vec<HN_factors> local_factors;
+                    for(int i = i_begin; i < i_end; i++){
+                        point.first = xs[i];
+                        local_factors.clear();
+                        process_summand_at_grid_cell(i, j, k, point, *summands[k], grid_location, sweeps[k].local_row_data,
+                            local_factors, worker_dimensions[worker], slope_bounds, worker_decomposers[worker]);
+                        summand_streams[k][i] = k_merge(local_factors);
+                    }
+                }});
+            };
+            for(int i = 0; i < grid_length_x; i++){
+                current_grid_degree.first = xs[i];
+                update_grid_location_x_of_summand(current_grid_degree, M, sweep.grid_location.first, k);
+                if(sweep.grid_location.first != cell_x){
+                    submit_cell(cell_begin, i, cell_x);
+                    cell_begin = i;
+                    cell_x = sweep.grid_location.first;
+                }
+            }
+            submit_cell(cell_begin, grid_length_x, cell_x);
+        }
+        pool.run_batch(tasks);
+
+        r2degree current_grid_degree = row_start;
         for(int i = 0; i < grid_length_x; i++){
-            current_grid_degree.first += grid_step.first; 
-            // Then we need to check if we have crossed into a new grid-square in any local grid.    
-            update_grid_locations_x(current_grid_degree, indecomps, grid_locations);
-
-            ostream << "G," << i << "," << j << ", " << current_grid_degree << "\n";
-            if (progress_bar) {
-                int points_processed = j * grid_length_x + i;
-                std::string name = "Grid point";
-                show_progress_bar(points_processed, grid_size, name);
+            current_grid_degree.first = xs[i];
+            write_grid_point(ostream, i, j, current_grid_degree);
+            vec<HN_factors> cell_streams;
+            for(int k = 0; k < num_summands; k++){
+                if(!summand_streams[k][i].empty()){
+                    cell_streams.emplace_back(std::move(summand_streams[k][i]));
+                    summand_streams[k][i].clear();
+                }
             }
-            // Now actually compute the HNF, but use the data previously computed 
-            composition_factors.clear();
-            process_grid_cell(i, j, current_grid_degree, indecomps, grid_locations, local_grid_row_data, 
-               composition_factors, grid_ind_dimensions, all_scss_dimensions, subspaces, slope_bounds, decomposer);
+            HN_factors filtration = k_merge(cell_streams);
+            write_filtration(ostream, filtration, all_scss_dimensions);
+        }
+        if (progress_bar) {
+            int points_processed = (j+1) * grid_length_x - 1;
+            std::string name = "Grid point";
+            show_progress_bar(points_processed, grid_size, name);
+        }
+    }
 
-               // Need to recalculate the slope values of the actual filtration from the factors.
+    vec<int> grid_ind_dimensions;
+    for(auto& dimensions : worker_dimensions){
+        grid_ind_dimensions.insert(grid_ind_dimensions.end(), dimensions.begin(), dimensions.end());
+    }
+    print_sweep_statistics(grid_ind_dimensions, all_scss_dimensions);
+}
 
+/**
+* @brief Instead of sampling the grid, writes for every indecomposable and each of its local cells
+* the regions on which the HN types of the local summands are constant, with the slope polynomials of their factors.
+* The result has the format
+*   HNR
+*   lower_bound,upper_bound,slope_lower_bound,slope_upper_bound
+* followed by a record "C,k,x0,y0,x1,y1" for every local cell of the k-th indecomposable,
+* and then one region record per local summand, see write_summand_regions.
+* sky_from_regions rasterises such a file to a .sky file of any resolution.
+*/
+template<typename Container, typename Outputstream>
+void process_summands_regions(aida::AIDA_functor& decomposer, 
+    Outputstream& ostream, 
+    const int& grid_length_x, const int& grid_length_y, 
+    Container& indecomps) {
 
-            HN_factors filtration = sort_merge(composition_factors);
+    bool progress_bar, show_info;
+    auto [lower_bound, upper_bound, grid_step, slope_bounds] = prepare_smart_grid(decomposer, grid_length_x, grid_length_y, indecomps, progress_bar, show_info);
+    ostream << "HNR" << "\n";
+    ostream << lower_bound << "," << upper_bound << "," << slope_bounds.first << "," << slope_bounds.second << "\n";
 
-            for(auto& hn_factor : filtration){
-                int k = hn_factor.d1.get_num_rows();
-                all_scss_dimensions.push_back(k);
-                if(hn_factor.slope_value == INFINITY){
-                    std::cout << "  There are unbounded modules in the decomposition." << std::endl;
-                    std::cout << "  Consider passing a bound." << std::endl;
-                    assert(false);
+    hnf_search_config().slope_subdivision = true;
+    vec<int> grid_ind_dimensions;
+    int num_cells = 0;
+    int num_unresolved = 0;
+    int k = 0;
+    int num_indecomps = indecomps.size();
+    for(R2Mat& M : indecomps){
+        Dynamic_HNF row_data;
+        for(int y_index = 0; y_index < static_cast<int>(M.y_grid.size()); y_index++){
+            row_data.compute_HNF_row(decomposer, M, y_index, slope_bounds);
+            double y_next = y_index + 1 < static_cast<int>(M.y_grid.size()) ? M.y_grid[y_index+1] : slope_bounds.second.second;
+            for(int x_index = 0; x_index < static_cast<int>(M.x_grid.size()); x_index++){
+                row_data.compute_cell(decomposer, M, x_index);
+                const vec<Uni_B1>& local_summands = row_data.indecomposable_summands[x_index];
+                if(local_summands.empty()){
+                    continue;
                 }
-                if(k ==1){
-                    to_stream(ostream, hn_factor);
-                } else {
-                    // Need to split into intervals:
-                    auto intervals = split_into_intervals(hn_factor);
-                    for(auto& interval : intervals){
-                        to_stream(ostream, interval);
+                double x_next = x_index + 1 < static_cast<int>(M.x_grid.size()) ? M.x_grid[x_index+1] : slope_bounds.second.first;
+                r2degree cell_start = {M.x_grid[x_index], M.y_grid[y_index]};
+                r2degree cell_boundary = {x_next, y_next};
+                ostream << "C," << k << "," << cell_start.first << "," << cell_start.second 
+                    << "," << cell_boundary.first << "," << cell_boundary.second << "\n";
+                for(size_t s = 0; s < local_summands.size(); s++){
+                    if(!write_summand_regions(ostream, local_summands[s], row_data.subdivisions[x_index][s].get(), cell_start, cell_boundary)){
+                        num_unresolved++;
                     }
                 }
+                num_cells++;
             }
         }
+        grid_ind_dimensions.insert(grid_ind_dimensions.end(), row_data.grid_ind_dimensions.begin(), row_data.grid_ind_dimensions.end());
+        k++;
+        if(progress_bar){
+            std::string name = "Indecomposable";
+            show_progress_bar(k, num_indecomps, name);
+        }
     }
 
-    std::cout << std::endl;
-    std::cout << "  Tracked the dimensions of " << grid_ind_dimensions.size() << " indecomposable summands." << std::endl;
-    std::cout << "  The dimensions of indecomposable summands at the grid points are distributed as:" << std::endl;
-    calculate_stats(grid_ind_dimensions);
-    std::cout << "  The dimensions of the composition factors at the grid points are distributed as:" << std::endl;
-    calculate_stats(all_scss_dimensions);
+    if(show_info){
+        std::cout << std::endl << "  Wrote the regions of " << num_cells << " local cells." << std::endl;
+        if(num_unresolved > 0){
+            std::cout << "  " << num_unresolved << " local summands had no exact subdivision and are left empty." << std::endl;
+        }
+        calculate_stats(grid_ind_dimensions);
+    }
+}
+
+/**
+* @brief Region files only exist as text.
+*/
+template<typename Container>
+void process_summands_regions(aida::AIDA_functor&, Sky_cell_sink&, const int&, const int&, Container&) {
+    throw std::invalid_argument("Region files have no binary, HDF5 or dictionary format.");
+}
+
+/**
+* @brief Chooses the engine for the sweep over the dynamic grid.
+*/
+template<typename Container, typename Outputstream>
+void process_summands_dynamic_grid(aida::AIDA_functor& decomposer, 
+    Outputstream& ostream, 
+    const int& grid_length_x, const int& grid_length_y, 
+    Container& indecomps, const Sweep_options& options) {
+    if(options.region_output){
+        process_summands_regions(decomposer, ostream, grid_length_x, grid_length_y, indecomps);
+    } else if(options.cell_tasks){
+        process_summands_cell_tasks(decomposer, ostream, grid_length_x, grid_length_y, indecomps, options.num_threads);
+    } else if(options.per_summand_tasks){
+        process_summands_per_summand(decomposer, ostream, grid_length_x, grid_length_y, indecomps, options.num_threads);
+    } else if(options.num_threads > 1){
+        process_summands_smart_grid_parallel(decomposer, ostream, grid_length_x, grid_length_y, indecomps, options.num_threads);
+    } else {
+        process_summands_smart_grid(decomposer, ostream, grid_length_x, grid_length_y, indecomps, options.pipeline);
+    }
 }
 
 template <typename Outputstream>
@@ -687,14 +1263,15 @@ void full_grid_induced_decomposition(aida::AIDA_functor& decomposer,
     bool dynamic_grid = true,
     bool is_decomposed = false,
     const int& grid_length_x = 200, const int& grid_length_y = 200,
-    const int subspace_dim = -1) {
+    const int subspace_dim = -1,
+    const Sweep_options& options = Sweep_options()) {
 
     if(is_decomposed){
         vec<R2Mat> matrices;
         graded_linalg::read_sccsum(matrices, istream);
         vec<r2degree> grid_points;
         if(dynamic_grid){
-            process_summands_smart_grid(decomposer, ostream, grid_length_x, grid_length_y, matrices);
+            process_summands_dynamic_grid(decomposer, ostream, grid_length_x, grid_length_y, matrices, options);
         } else {
             process_summands_fixed_grid(decomposer, ostream, grid_length_x, grid_length_y, matrices);
         }
@@ -712,7 +1289,7 @@ void full_grid_induced_decomposition(aida::AIDA_functor& decomposer,
         }
         vec<r2degree> grid_points;
         if(dynamic_grid){
-            process_summands_smart_grid(decomposer, ostream, grid_length_x, grid_length_y, B_list);
+            process_summands_dynamic_grid(decomposer, ostream, grid_length_x, grid_length_y, B_list, options);
         } else {
             process_summands_fixed_grid(decomposer, ostream, grid_length_x, grid_length_y, B_list);
         }
@@ -4,6 +4,7 @@
 #define HNF_AT_HEADER_HPP
 
 #include "uni_b1.hpp"
+#include "relation_staircase.hpp"
 
 namespace hnf {
 
@@ -20,17 +21,197 @@ HN_factors k_merge(vec<HN_factors>& sorted_lists);
 
 void recalculate_slopes(HN_factors& composition_factors);
 
+// Slopes which differ by less than this relative amount are tied, the searches compute areas in different ways.
+constexpr double scss_tolerance = 1e-9;
+
+/**
+ * @brief Picks the scss among the subspaces offered to it. Every subspace whose slope lies within a relative scss_tolerance
+ * of the exact maximal slope is tied, and of those the smallest dimension wins, then the lexicographically smallest
+ * reduced row echelon form. Since the maximum is kept separately from the winner, the winner only depends on the set
+ * of offered slopes, not on their order. Subspaces are given by rows, as bitmasks over the generators.
+ */
+struct Scss_candidates {
+
+    void offer(double slope, const uint64_t* rows, size_t dim);
+
+    void offer(double slope, const vec<uint64_t>& rows) { offer(slope, rows.data(), rows.size()); }
+
+    double max_slope() const { return maximum; }
+
+    /**
+     * @brief Subspaces of smaller slope can not win any more, the searches prune below it.
+     */
+    double threshold() const { return maximum * (1 - scss_tolerance); }
+
+    /**
+     * @brief Rows of the winner as they were offered, empty if nothing has been offered.
+     */
+    const vec<uint64_t>& winner() const;
+
+  private:
+    struct Candidate {
+        double slope;
+        vec<uint64_t> rows;
+        vec<uint64_t> echelon_form;
+    };
+    double maximum = 0;
+    // The subspaces within the tolerance of maximum.
+    vec<Candidate> tied;
+    size_t best = 0;
+};
+
+/**
+ * @brief Searches all subspaces in grassmannians, where grassmannians[d] are the subspaces of dimension d 
+ * of the generators of X, for the one generating the submodule of maximal slope.
+ * Ties are broken by Scss_candidates, as in every find_scss_* search, so on the same slopes they all return the same subspace.
+ */
+Uni_B1 find_scss_bruteforce(const R2Mat& X,
+        const vec<vec<SparseMatrix<int>>>& grassmannians,
+        R2Mat& max_subspace,
+        const pair<r2degree>& bounds,
+        const bool filter = false);
+
 Uni_B1 find_scss_bruteforce(const R2Mat& X,
         vec<vec<vec<SparseMatrix<int>>>>& subspaces,
         R2Mat& max_subspace,
         const pair<r2degree>& bounds,
         const bool filter = false);
 
+/**
+ * @brief Same result as find_scss_bruteforce for a bounded X. The subspaces of each dimension are visited in Gray code order
+ * and their areas are updated from the previous subspace with the staircase of X, 
+ * only the winning subspace is turned into a submodule.
+ */
+Uni_B1 find_scss_incremental(const R2Mat& X,
+        const Relation_staircase& staircase,
+        R2Mat& max_subspace,
+        const pair<r2degree>& bounds,
+        const bool filter = false);
+
+// Largest number of generators for which find_scss_fixed has a specialised search.
+constexpr int max_fixed_dim = 6;
+
+// Largest number of generators for the branch and bound search, it stores the area of every vector.
+constexpr int max_branch_and_bound_dim = 20;
+
+/**
+ * @brief Same result as find_scss_incremental for a bounded X without filter, for 2 to max_fixed_dim generators.
+ * Dispatches on the number of generators to a search over the compile-time list fixed_grassmannian
+ * which only uses fixed-size storage inside the loop.
+ * The slope of seed_rows, if they span a subspace, is evaluated first and lets the search stop summing up areas early.
+ */
+Uni_B1 find_scss_fixed(const R2Mat& X,
+        const Relation_staircase& staircase,
+        R2Mat& max_subspace,
+        const pair<r2degree>& bounds,
+        const vec<uint64_t>& seed_rows = vec<uint64_t>());
+
+/**
+ * @brief How find_scss searches the subspaces. Set once, before the computation starts.
+ */
+struct HNF_search_config {
+    // Branch and bound instead of visiting every subspace. Searches with filter are always exhaustive.
+    bool branch_and_bound = true;
+    // Reuse the filtrations of presentations which agree up to translation, see HNF_cache.
+    bool memo_cache = true;
+    // Precompute the HN types of every summand over its local cell as a Slope_subdivision and look them up.
+    bool slope_subdivision = false;
+};
+
+HNF_search_config& hnf_search_config();
+
+/**
+ * @brief Same result as find_scss_bruteforce, but prunes every subtree of subspaces whose slope is 
+ * bounded by the current maximum. The bounds come from the areas of the submodules generated by single vectors
+ * and from the region where X has no relations yet. If X is bounded, the areas of the candidates come from its staircase
+ * and only the winning subspace gets a resolution.
+ * seed_rows, as bitmasks over the generators of X, is evaluated first so that the search starts with its slope as maximum.
+ * X with more than max_branch_and_bound_dim generators goes to find_scss_streaming.
+ */
+Uni_B1 find_scss_branch_and_bound(const R2Mat& X,
+        R2Mat& max_subspace,
+        const pair<r2degree>& bounds,
+        const vec<uint64_t>& seed_rows = vec<uint64_t>());
+
+/**
+ * @brief Same as find_scss_bruteforce, but the subspaces are enumerated one at a time by a Grassmannian_enumerator.
+ * Memory does not depend on the dimension of X.
+ */
+Uni_B1 find_scss_streaming(const R2Mat& X,
+        R2Mat& max_subspace,
+        const pair<r2degree>& bounds,
+        const bool filter = false);
+
+/**
+ * @brief Finds the scss of X as configured in hnf_search_config. Bounded modules with at most max_fixed_dim generators 
+ * always use find_scss_fixed. The branch and bound search takes at most max_branch_and_bound_dim generators. Otherwise the exhaustive search is incremental if X is bounded,
+ * otherwise it takes the subspaces from the shared Grassmannian_table, or streams them if X has too many generators for the table.
+ * seed_rows is a guess for the scss, e.g. from a neighbouring grid point, and warm-starts the fixed and the branch and bound search.
+ */
+Uni_B1 find_scss(const R2Mat& X,
+        R2Mat& max_subspace,
+        const pair<r2degree>& bounds,
+        const bool filter = false,
+        const vec<uint64_t>& seed_rows = vec<uint64_t>());
+
 void skyscraper_invariant(const R2Mat& input,
     vec<HN_factors>& result,
     vec<vec<vec<SparseMatrix<int>>>>& subspaces,
     const pair<r2degree>& bounds, const bool filter = false);
 
+/**
+ * @brief Appends the HN filtration of input to result, using the shared Grassmannian_table.
+ */
+void skyscraper_invariant(const R2Mat& input,
+    vec<HN_factors>& result,
+    const pair<r2degree>& bounds, const bool filter = false);
+
+/**
+ * @brief HN filtration of a bounded, uniquely generated module, reusable while its generators move 
+ * inside one cell of the grid of relation degrees. Every factor carries the area polynomial in the shift of the generator degree,
+ * so at a shifted degree only the slopes have to be evaluated.
+ */
+struct Shiftable_filtration {
+    bool valid = false;
+    r2degree generator_degree;
+    HN_factors factors;
+    // Rows of the scss of each quotient in the last computation, seeds the next computation in the same cell.
+    vec<vec<uint64_t>> chain;
+
+    /**
+     * @brief For every factor, the smallest area per dimension of any other subspace of its quotient in the last computation,
+     * and the edge lengths of the staircase of the quotient, which bound how fast these areas can shrink.
+     */
+    struct Margin {
+        double runner_up;
+        double left_edge;
+        double bottom_edge;
+    };
+    vec<Margin> margins;
+
+    /**
+     * @brief Computes the filtration of X. Returns false, and leaves the filtration invalid, if X is not bounded.
+     */
+    bool compute(const R2Mat& X, const pair<r2degree>& bounds);
+
+    /**
+     * @brief Writes the factors with the generators moved to degree, which has to lie in the same cell.
+     * Returns false unless the margins prove that every scss of the chain still beats all other subspaces of its quotient,
+     * then the filtration has to be recomputed. Quotients with more than max_fixed_dim generators have no margin.
+     */
+    bool shift(const r2degree& degree, const pair<r2degree>& bounds, HN_factors& result) const;
+};
+
+template<typename Container>
+vec<HN_factors> skyscraper_invariant_sum(Container& summands,
+        const pair<r2degree>& bounds, const bool filter = false) {
+    vec<HN_factors> result;
+    for(R2Mat& X : summands){
+        skyscraper_invariant(X, result, bounds, filter);
+    }
+    return result;
+}
+
 template<typename Container>
 vec<HN_factors> skyscraper_invariant_sum(Container& summands,
         vec<vec<vec<SparseMatrix<int>>>>& subspaces,
@@ -67,6 +248,18 @@ void skyscraper_invariant_sum_append(Container& summands,
     }
 }
 
+template<typename Container>
+void skyscraper_invariant_sum_append(Container& summands, 
+        vec<HN_factors> & result,
+        const pair<r2degree>& bounds, const bool filter = false) {
+    for(R2Mat& X : summands){
+        if(X.get_num_rows() == 0){
+            continue;
+        }
+        skyscraper_invariant(X, result, bounds, filter);
+    }
+}
+
 
 
 } // namespace hnf
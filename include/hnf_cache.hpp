@@ -0,0 +1,67 @@
+#pragma once
+
+#ifndef HNF_CACHE_HPP
+#define HNF_CACHE_HPP
+
+#include "uni_b1.hpp"
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace hnf {
+
+/**
+ * @brief Process-wide cache of the HN filtrations computed by skyscraper_invariant.
+ * Presentations are keyed up to translation and the choice of relations: the degrees of the relations are taken relative to
+ * the degree of the generators, and every relation degree contributes the span of the relations below it in normal form.
+ * Bounded modules only depend on the size of the range of the bounds, unbounded ones on the bounds relative to the generators.
+ * A filtration is stored as its chain of destabilising subspaces,
+ * so that a hit only has to rebuild the factors and their slopes.
+ * The cache is split into shards with a mutex each, so threads rarely wait for each other.
+ */
+struct HNF_cache {
+
+    // Rows of the destabilising subspace of every step, over the generators of the quotient at that step.
+    using Chain = vec<vec<uint64_t>>;
+
+    /**
+     * @brief Key of a uniquely generated presentation with at most 64 generators.
+     */
+    static std::string key(const R2Mat& X, const pair<r2degree>& bounds);
+
+    /**
+     * @brief Copies the chain stored under key to chain, returns false if there is none.
+     */
+    static bool lookup(const std::string& key, Chain& chain);
+
+    static void insert(const std::string& key, Chain chain);
+
+    static size_t hits();
+    static size_t misses();
+
+    static void print_statistics();
+
+  private:
+    static constexpr size_t num_shards = 64;
+    // Once a shard is full, new filtrations are no longer stored.
+    static constexpr size_t max_entries_per_shard = size_t(1) << 15;
+
+    struct Shard {
+        std::mutex mutex;
+        std::unordered_map<std::string, Chain> chains;
+    };
+
+    std::array<Shard, num_shards> shards;
+    std::atomic<size_t> num_hits{0};
+    std::atomic<size_t> num_misses{0};
+
+    static HNF_cache& instance();
+    static Shard& shard_of(const std::string& key);
+};
+
+} // namespace hnf
+
+#endif // HNF_CACHE_HPP
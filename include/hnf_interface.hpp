@@ -1,2 +1,8 @@
 #include "hnf.hpp"
+#include "sky_stream_writer.hpp"
+#include "sky_binary.hpp"
+#include "sky_dictionary.hpp"
+#ifdef SKYSCRAPER_HDF5
+#include "sky_hdf5.hpp"
+#endif
 #include "filt_landscape.hpp"
\ No newline at end of file
@@ -0,0 +1,62 @@
+#pragma once
+
+#ifndef REGION_FILE_HPP
+#define REGION_FILE_HPP
+
+#include <array>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+namespace hnf {
+
+struct Region_subdivision;
+
+/**
+ * @brief A convex region of a local cell on which one HN factor has a fixed presentation.
+ */
+struct Region_face {
+    int dim;
+    // area = p[0] + p[1]*x + p[2]*y + dim*x*y/range_area for a shift (x,y) from the corner of the cell.
+    std::array<double, 3> area_polynomial;
+    // Relative to the corner of the cell, in counterclockwise order.
+    std::vector<std::pair<double, double>> vertices;
+    // Relations of every interval of the factor.
+    std::vector<std::vector<std::pair<double, double>>> intervals;
+    // Regions of the quotient by the factor, nullptr if the filtration ends here.
+    std::unique_ptr<Region_subdivision> quotient;
+};
+
+struct Region_subdivision {
+    std::vector<Region_face> faces;
+};
+
+struct Region_cell {
+    int summand;
+    std::pair<double, double> start, end;
+    // One subdivision per local summand. Empty for summands without an exact subdivision.
+    std::vector<Region_subdivision> summands;
+};
+
+struct Region_data {
+    std::pair<double, double> lower_bound, upper_bound;
+    std::pair<double, double> slope_lower_bound, slope_upper_bound;
+    std::vector<Region_cell> cells;
+};
+
+/**
+ * @brief Reads a file written by process_summands_regions.
+ */
+Region_data regions_from_file(const std::string& filename);
+
+/**
+ * @brief Evaluates the regions on an n_x x n_y grid over [lower_bound, upper_bound] and writes the HN filtrations
+ * at the grid points in the .sky format, as the sweep over the dynamic grid would have written them.
+ * Returns the number of grid points at which some local summand had no region containing the point.
+ */
+size_t rasterise_regions(const Region_data& regions, int n_x, int n_y, std::ostream& ostream);
+
+} // namespace hnf
+
+#endif // REGION_FILE_HPP
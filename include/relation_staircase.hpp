@@ -0,0 +1,99 @@
+#pragma once
+
+#ifndef RELATION_STAIRCASE_HPP
+#define RELATION_STAIRCASE_HPP
+
+#include "f2_matrix.hpp"
+#include <array>
+#include <cstdint>
+
+namespace hnf {
+
+/**
+ * @brief The dimension function of the submodules of a uniquely generated module X, without resolutions.
+ * For a subspace V of the generators, dim <V>_p = rank(V mod R_p), where R_p is the span of the relations of degree <= p.
+ * The relation degrees cut the plane into cells on which R_p is constant. Cells with the same R_p are merged into groups,
+ * storing the normal form of every generator modulo R_p, so that
+ * area(<V>) = sum over groups of (area of the group) * rank(V mod R_p).
+ * Generators and subspaces are bitmasks, so X can have at most 64 generators.
+ */
+struct Relation_staircase {
+
+    Relation_staircase(const R2Mat& X, const pair<r2degree>& bounds);
+
+    /**
+     * @brief False if X is not bounded, then areas have to be computed from the resolution instead.
+     */
+    bool bounded() const { return is_bounded; }
+
+    int num_generators() const { return k; }
+    int num_groups() const { return group_areas.size(); }
+    double group_area(int g) const { return group_areas[g]; }
+
+    /**
+     * @brief Normalised area of the submodule generated by the vectors in rows, as in Uni_B1::area(bounds).
+     */
+    double area(const vec<uint64_t>& rows) const;
+
+    /**
+     * @brief Coefficients of the area of the submodule generated by rows as a function of a shift (x, y) 
+     * of the generator degree which stays inside the cell of the grid of relation degrees:
+     * area = p[0] + p[1]*x + p[2]*y + dim*x*y/range_area, in the layout of Uni_B1::area_polynomial.
+     */
+    std::array<double, 3> area_polynomial(const vec<uint64_t>& rows) const;
+
+    /**
+     * @brief Normalised length of the left and of the lower edge of the staircase. Per dimension of a submodule,
+     * moving the generators by (x, y) with x, y >= 0 cuts off at most x*left_edge_length() + y*bottom_edge_length() of its area.
+     */
+    double left_edge_length() const;
+    double bottom_edge_length() const;
+
+    /**
+     * @brief Area of the region above the generators where X has no relations.
+     */
+    double free_area() const { return no_relations_area; }
+
+    /**
+     * @brief Normal form of the generator q modulo the relations of group g.
+     */
+    uint64_t reduced_generator(int g, int q) const { return reduced_generators[g * k + q]; }
+
+  private:
+    int k;
+    bool is_bounded = true;
+    double no_relations_area = 0;
+    vec<double> group_areas;
+    // (group, normalised length) of the cells along the left and the lower edge of the staircase.
+    vec<std::pair<int, double>> left_edge;
+    vec<std::pair<int, double>> bottom_edge;
+    // reduced_generators[g*k + q] is the normal form of the q-th generator modulo the relations of group g.
+    vec<uint64_t> reduced_generators;
+};
+
+/**
+ * @brief The area of the submodule generated by a subspace, kept up to date while the subspace changes one entry at a time.
+ * Every row of the subspace is stored in normal form modulo the relations of every group,
+ * so changing an entry of a row costs one XOR per group.
+ */
+struct Subspace_area {
+
+    Subspace_area(const Relation_staircase& staircase, const vec<uint64_t>& rows);
+
+    /**
+     * @brief Adds the generator column to the row-th row of the subspace.
+     */
+    void flip(int row, int column);
+
+    double area() const;
+
+  private:
+    const Relation_staircase& staircase;
+    int d;
+    // reduced_rows[g*d + r] is the r-th row modulo the relations of group g.
+    vec<uint64_t> reduced_rows;
+};
+
+} // namespace hnf
+
+#endif // RELATION_STAIRCASE_HPP
@@ -0,0 +1,261 @@
+#pragma once
+
+#ifndef SKY_BINARY_HPP
+#define SKY_BINARY_HPP
+
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace hnf {
+
+/**
+ * @brief Receives the content of a .sky file one grid cell at a time, in the order of the file.
+ */
+struct Sky_cell_sink {
+
+    virtual ~Sky_cell_sink() = default;
+
+    virtual void header(int n_x, int n_y,
+        const std::pair<double, double>& lower_bound,
+        const std::pair<double, double>& upper_bound,
+        const std::pair<double, double>& grid_step) = 0;
+
+    /**
+     * @brief Starts the cell (i, j) at the grid point (x, y). Factors added afterwards belong to it.
+     */
+    virtual void cell(int i, int j, double x, double y) = 0;
+
+    /**
+     * @brief Adds an interval with the given slope and relation degrees to the current cell.
+     */
+    virtual void factor(double slope, const std::vector<std::pair<double, double>>& relations) = 0;
+
+    /**
+     * @brief Writes everything that is still buffered. Nothing may be added afterwards.
+     */
+    virtual void finish() = 0;
+};
+
+/**
+ * @brief Keeps the cells passed to it in memory until they are replayed to another sink,
+ * e.g. for a band of rows which is computed before the rows below it are written.
+ * The header is not kept.
+ */
+struct Sky_cell_buffer : public Sky_cell_sink {
+
+    void header(int, int,
+        const std::pair<double, double>&,
+        const std::pair<double, double>&,
+        const std::pair<double, double>&) override {}
+
+    void cell(int i, int j, double x, double y) override;
+
+    void factor(double slope, const std::vector<std::pair<double, double>>& relations) override;
+
+    void finish() override {}
+
+    /**
+     * @brief Passes the cells on to sink in the order they arrived, without finishing it.
+     */
+    void replay(Sky_cell_sink& sink) const;
+
+  private:
+    struct Cell {
+        int i, j;
+        double x, y;
+        size_t first_factor;
+    };
+    struct Factor {
+        double slope;
+        size_t first_relation;
+    };
+    std::vector<Cell> cells;
+    std::vector<Factor> factors;
+    std::vector<std::pair<double, double>> relations;
+};
+
+/**
+ * @brief Writes the binary .skb version of the .sky format to out, one grid cell at a time.
+ * Only the byte offsets of the cells are kept in memory, they form the index at the end of the file.
+ */
+struct Sky_binary_builder : public Sky_cell_sink {
+
+    explicit Sky_binary_builder(std::ostream& out);
+
+    void header(int n_x, int n_y,
+        const std::pair<double, double>& lower_bound,
+        const std::pair<double, double>& upper_bound,
+        const std::pair<double, double>& grid_step) override;
+
+    void cell(int i, int j, double x, double y) override;
+
+    void factor(double slope, const std::vector<std::pair<double, double>>& relations) override;
+
+    /**
+     * @brief Writes the last cell and the index.
+     */
+    void finish() override;
+
+  private:
+    std::ostream& out;
+    int n_x = 0;
+    int n_y = 0;
+    uint64_t position = 0;
+    // offsets[j*n_x + i] is the byte offset of the cell (i, j), 0 if it has not been written.
+    std::vector<uint64_t> offsets;
+    int current = -1;
+    uint64_t num_factors = 0;
+    std::vector<char> record;
+    bool finished = false;
+
+    void write_cell();
+};
+
+/**
+ * @brief Writes the text .sky format, as hnf_main writes it, to out.
+ */
+struct Sky_text_writer : public Sky_cell_sink {
+
+    explicit Sky_text_writer(std::ostream& out);
+
+    void header(int n_x, int n_y,
+        const std::pair<double, double>& lower_bound,
+        const std::pair<double, double>& upper_bound,
+        const std::pair<double, double>& grid_step) override;
+
+    void cell(int i, int j, double x, double y) override;
+
+    void factor(double slope, const std::vector<std::pair<double, double>>& relations) override;
+
+    void finish() override;
+
+  private:
+    std::ostream& out;
+};
+
+/**
+ * @brief Parses the lines of a text .sky file and passes them on to a Sky_cell_sink.
+ */
+struct Sky_text_parser {
+
+    explicit Sky_text_parser(Sky_cell_sink& sink) : sink(sink) {}
+
+    // line without the line break.
+    void line(const std::string& line);
+
+  private:
+    Sky_cell_sink& sink;
+    int line_number = 0;
+    int n_x = 0;
+    int n_y = 0;
+};
+
+/**
+ * @brief A binary .skb file, memory-mapped. Every cell is found through the index in constant time.
+ */
+struct Sky_binary_file {
+
+    int n_x = 0;
+    int n_y = 0;
+    std::pair<double, double> lower_bound, upper_bound, grid_step;
+
+    /**
+     * @brief Maps filename and checks every cell record against the index,
+     * throws std::runtime_error if it is not a binary .sky file or a record is corrupt.
+     */
+    explicit Sky_binary_file(const std::string& filename);
+    ~Sky_binary_file();
+
+    Sky_binary_file(const Sky_binary_file&) = delete;
+    Sky_binary_file& operator=(const Sky_binary_file&) = delete;
+
+    bool has_cell(int i, int j) const;
+
+    /**
+     * @brief The grid point of the cell (i, j).
+     */
+    std::pair<double, double> grid_point(int i, int j) const;
+
+    /**
+     * @brief Calls f(slope, relations) for every factor of the cell (i, j), in the order of the file.
+     * relations points to num_relations pairs of x- and y-coordinates.
+     */
+    template<typename F>
+    void for_each_factor(int i, int j, F f) const {
+        if(!has_cell(i, j)){
+            return;
+        }
+        size_t position = cell_offset(i, j) + 2*sizeof(double);
+        uint64_t num_factors = read_u64(position);
+        std::vector<double> relations;
+        for(uint64_t s = 0; s < num_factors; s++){
+            double slope = read_double(position);
+            uint64_t num_relations = read_u64(position);
+            relations.resize(2*num_relations);
+            for(double& coordinate : relations){
+                coordinate = read_double(position);
+            }
+            f(slope, relations.data(), static_cast<size_t>(num_relations));
+        }
+    }
+
+    /**
+     * @brief True if filename starts with the magic of the binary format.
+     */
+    static bool is_binary(const std::string& filename);
+
+  private:
+    const char* data = nullptr;
+    size_t size = 0;
+    size_t index_offset = 0;
+
+    uint64_t cell_offset(int i, int j) const;
+    // True if the cell record at offset lies between the header and the index.
+    bool valid_record(uint64_t offset) const;
+    uint64_t read_u64(size_t& position) const;
+    double read_double(size_t& position) const;
+};
+
+/**
+ * @brief Passes the content of an indexed .sky file, e.g. a Sky_binary_file, to sink in the order of the grid.
+ */
+template<typename File>
+void replay_cells(const File& file, Sky_cell_sink& sink) {
+    sink.header(file.n_x, file.n_y, file.lower_bound, file.upper_bound, file.grid_step);
+    std::vector<std::pair<double, double>> relations;
+    for(int j = 0; j < file.n_y; j++){
+        for(int i = 0; i < file.n_x; i++){
+            if(!file.has_cell(i, j)){
+                continue;
+            }
+            auto point = file.grid_point(i, j);
+            sink.cell(i, j, point.first, point.second);
+            file.for_each_factor(i, j, [&](double slope, const double* coordinates, size_t num_relations) {
+                relations.clear();
+                for(size_t r = 0; r < num_relations; r++){
+                    relations.emplace_back(coordinates[2*r], coordinates[2*r + 1]);
+                }
+                sink.factor(slope, relations);
+            });
+        }
+    }
+    sink.finish();
+}
+
+/**
+ * @brief Converts a text .sky file to the binary format.
+ */
+void sky_text_to_binary(const std::string& input, const std::string& output);
+
+/**
+ * @brief Converts a binary .skb file to the text format, as hnf_main writes it.
+ */
+void sky_binary_to_text(const std::string& input, const std::string& output);
+
+} // namespace hnf
+
+#endif // SKY_BINARY_HPP
@@ -0,0 +1,159 @@
+#pragma once
+
+#ifndef SKY_DICTIONARY_HPP
+#define SKY_DICTIONARY_HPP
+
+#include "sky_binary.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace hnf {
+
+/**
+ * @brief Writes the dictionary encoded .skd version of the .sky format to out.
+ * The relations of an interval do not change while the sweep moves through its local cell,
+ * so every distinct staircase of relations is stored once and the cells refer to it by its id.
+ * A run of cells in a row with the same (staircase id, slope) pairs is stored once, with the grid point
+ * of its first cell and the step to the next, unless they continue those of the run before.
+ * A run only continues while adding the step reproduces the grid points exactly, so they are read back without change.
+ */
+struct Sky_dictionary_builder : public Sky_cell_sink {
+
+    explicit Sky_dictionary_builder(std::ostream& out);
+
+    void header(int n_x, int n_y,
+        const std::pair<double, double>& lower_bound,
+        const std::pair<double, double>& upper_bound,
+        const std::pair<double, double>& grid_step) override;
+
+    void cell(int i, int j, double x, double y) override;
+
+    void factor(double slope, const std::vector<std::pair<double, double>>& relations) override;
+
+    /**
+     * @brief Writes the last run and the dictionary.
+     */
+    void finish() override;
+
+    size_t num_staircases() const { return ids.size(); }
+
+  private:
+    std::ostream& out;
+    int n_x = 0;
+    int n_y = 0;
+    std::pair<double, double> grid_step;
+    uint64_t position = 0;
+    // Staircases as their bytes in the file, and the dictionary section built from them.
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<char> dictionary;
+    std::string key;
+    // The open run covers the cells run_i, ..., run_i + run_length - 1 of the row run_j.
+    int run_i = -1;
+    int run_j = -1;
+    uint32_t run_length = 0;
+    // Whether the run stores its first grid point and step, or continues those of the last run.
+    bool run_stores_point = true;
+    std::pair<double, double> run_point, run_step;
+    // The grid point of the last cell of the run.
+    std::pair<double, double> last_point;
+    std::vector<char> run_factors;
+    // The cell whose factors are still being added.
+    int cell_i = -1;
+    int cell_j = -1;
+    std::pair<double, double> cell_point;
+    std::vector<char> cell_factors;
+    bool finished = false;
+
+    void close_cell();
+    void write_run();
+};
+
+/**
+ * @brief A dictionary encoded .skd file, memory-mapped. Reading it builds the index of the cells,
+ * afterwards it is used like a Sky_binary_file.
+ */
+struct Sky_dictionary_file {
+
+    int n_x = 0;
+    int n_y = 0;
+    std::pair<double, double> lower_bound, upper_bound, grid_step;
+
+    /**
+     * @brief Maps filename, throws std::runtime_error if it is not a dictionary encoded .sky file.
+     */
+    explicit Sky_dictionary_file(const std::string& filename);
+    ~Sky_dictionary_file();
+
+    Sky_dictionary_file(const Sky_dictionary_file&) = delete;
+    Sky_dictionary_file& operator=(const Sky_dictionary_file&) = delete;
+
+    bool has_cell(int i, int j) const;
+
+    /**
+     * @brief The grid point of the cell (i, j).
+     */
+    std::pair<double, double> grid_point(int i, int j) const;
+
+    size_t num_staircases() const { return staircases.size(); }
+
+    /**
+     * @brief Calls f(slope, relations) for every factor of the cell (i, j), in the order of the file.
+     * relations points to num_relations pairs of x- and y-coordinates.
+     */
+    template<typename F>
+    void for_each_factor(int i, int j, F f) const {
+        if(!has_cell(i, j)){
+            return;
+        }
+        size_t position = cells[static_cast<size_t>(j) * n_x + i];
+        uint32_t num_factors = read_u32(position);
+        std::vector<double> relations;
+        for(uint32_t s = 0; s < num_factors; s++){
+            uint32_t id = read_u32(position);
+            double slope = read_double(position);
+            size_t staircase = staircases[id];
+            uint32_t num_relations = read_u32(staircase);
+            relations.resize(2*num_relations);
+            for(double& coordinate : relations){
+                coordinate = read_double(staircase);
+            }
+            f(slope, relations.data(), static_cast<size_t>(num_relations));
+        }
+    }
+
+    /**
+     * @brief True if filename starts with the magic of the dictionary encoded format.
+     */
+    static bool is_dictionary(const std::string& filename);
+
+  private:
+    const char* data = nullptr;
+    size_t size = 0;
+    // Byte offset of the factors of the run containing the cell j*n_x + i, 0 if there is none.
+    std::vector<uint64_t> cells;
+    // The grid points, recomputed from the runs.
+    std::vector<std::pair<double, double>> points;
+    // Byte offset of every staircase.
+    std::vector<uint64_t> staircases;
+
+    uint32_t read_u32(size_t& position) const;
+    uint64_t read_u64(size_t& position) const;
+    double read_double(size_t& position) const;
+};
+
+/**
+ * @brief Converts a text or binary .sky file to the dictionary encoded format.
+ */
+void sky_to_dictionary(const std::string& input, const std::string& output);
+
+/**
+ * @brief Converts a dictionary encoded .skd file to the text format, as hnf_main writes it.
+ */
+void sky_dictionary_to_text(const std::string& input, const std::string& output);
+
+} // namespace hnf
+
+#endif // SKY_DICTIONARY_HPP
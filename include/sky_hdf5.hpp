@@ -0,0 +1,69 @@
+#pragma once
+
+#ifndef SKY_HDF5_HPP
+#define SKY_HDF5_HPP
+
+#include "sky_binary.hpp"
+#include <memory>
+#include <string>
+
+namespace hnf {
+
+/**
+ * @brief Writes the skyscraper invariant to an HDF5 file, one grid cell at a time.
+ * The cells have to arrive in the order of the grid, j*n_x + i increasing, as the sweep writes them.
+ *
+ * The root group has the attributes n_x, n_y, lower_bound, upper_bound and grid_step, and the datasets
+ *   grid_points    (n_x*n_y, 2) float64, the grid point of every cell, NaN for cells without output,
+ *   cell_offsets   (n_x*n_y + 1) uint64, the factors of the cell j*n_x + i are cell_offsets[c] to cell_offsets[c+1],
+ *   slopes         (number of factors) float64,
+ *   corner_offsets (number of factors + 1) uint64, the corners of the factor f are corner_offsets[f] to corner_offsets[f+1],
+ *   corners        (number of corners, 2) float64, the degrees of the relations of every factor.
+ * All datasets are chunked and compressed, so h5py can read slices of them without loading the whole file.
+ */
+struct Sky_hdf5_writer : public Sky_cell_sink {
+
+    /**
+     * @brief Creates or truncates path, throws std::runtime_error if this fails.
+     */
+    explicit Sky_hdf5_writer(const std::string& path, size_t chunk_size = size_t(1) << 16);
+    ~Sky_hdf5_writer() override;
+
+    void header(int n_x, int n_y,
+        const std::pair<double, double>& lower_bound,
+        const std::pair<double, double>& upper_bound,
+        const std::pair<double, double>& grid_step) override;
+
+    void cell(int i, int j, double x, double y) override;
+
+    void factor(double slope, const std::vector<std::pair<double, double>>& relations) override;
+
+    /**
+     * @brief Writes the remaining cells and closes the file.
+     */
+    void finish() override;
+
+  private:
+    // Keeps the HDF5 headers out of the rest of the code.
+    struct Datasets;
+    std::unique_ptr<Datasets> datasets;
+    int n_x = 0;
+    int n_y = 0;
+    // Index of the next cell whose offset has not been written.
+    size_t next_cell = 0;
+    uint64_t num_factors = 0;
+    uint64_t num_corners = 0;
+    bool in_cell = false;
+    bool finished = false;
+
+    void skip_cells_until(size_t cell_index);
+};
+
+/**
+ * @brief Converts a .sky file in the text, binary or dictionary encoded format to the HDF5 format.
+ */
+void sky_to_hdf5(const std::string& input, const std::string& output);
+
+} // namespace hnf
+
+#endif // SKY_HDF5_HPP
@@ -0,0 +1,79 @@
+#pragma once
+
+#ifndef SKY_STREAM_WRITER_HPP
+#define SKY_STREAM_WRITER_HPP
+
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace hnf {
+
+/**
+ * @brief Stream buffer with two blocks of fixed size. While the sweep fills one block,
+ * a background thread writes the other one to the file, so memory does not grow with the output.
+ * Flushing, e.g. by std::endl, does not hand over a block, only a full block or close does.
+ */
+struct Double_buffer : public std::streambuf {
+
+    // Writes to path, or discards everything if path is empty.
+    Double_buffer(const std::string& path, size_t block_size);
+    ~Double_buffer() override;
+
+    Double_buffer(const Double_buffer&) = delete;
+    Double_buffer& operator=(const Double_buffer&) = delete;
+
+    bool is_open() const { return file != nullptr || discard; }
+
+    /**
+     * @brief Writes the remaining output and waits for the writer thread. Returns false if a write failed.
+     */
+    bool close();
+
+  protected:
+    int_type overflow(int_type c) override;
+    std::streamsize xsputn(const char* s, std::streamsize n) override;
+    int sync() override { return 0; }
+
+  private:
+    std::FILE* file = nullptr;
+    bool discard = false;
+    std::vector<char> filling;
+    // The block handed to the writer thread, pending is true until it is on disk.
+    std::vector<char> writing;
+    size_t writing_size = 0;
+    bool pending = false;
+    bool stopping = false;
+    bool failed = false;
+    bool closed = false;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::thread writer;
+
+    void hand_over();
+    void writer_loop();
+};
+
+/**
+ * @brief Output stream for .sky files which writes to disk from a background thread, see Double_buffer.
+ */
+struct Sky_stream_writer : public std::ostream {
+
+    explicit Sky_stream_writer(const std::string& path, size_t block_size = size_t(1) << 22);
+
+    bool is_open() const { return buffer.is_open(); }
+
+    bool close() { return buffer.close(); }
+
+  private:
+    Double_buffer buffer;
+};
+
+} // namespace hnf
+
+#endif // SKY_STREAM_WRITER_HPP
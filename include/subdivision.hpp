@@ -4,10 +4,10 @@
 #define SUBDIVISION_HPP
 
 #include "uni_b1.hpp"
+#include "subdivision_lookup.hpp"
 #include <unistd.h>
 #include <getopt.h>
 #include <iomanip> 
-// #include <H5Cpp.h>
 #include <CGAL/Exact_predicates_exact_constructions_kernel.h>
 #include <CGAL/Surface_mesh.h>
 #include <CGAL/convex_hull_3.h>
@@ -15,10 +15,8 @@
 #include <CGAL/Arrangement_2.h>
 #include <CGAL/Arr_segment_traits_2.h>
 #include <CGAL/Arr_extended_dcel.h>
-#include <CGAL/Arr_naive_point_location.h>
+#include <CGAL/Arr_landmarks_point_location.h>
 
-// using namespace H5;
-// To-Do: Implement hdf5 output for the skyscraper invariant
 using namespace graded_linalg;
 
 namespace hnf{
@@ -43,14 +41,18 @@ struct Segment_w_labels {
 struct face_data{
     int subspace_index;
     std::array<double, 3> slope_polynomial;
+    // The scss on this face and the quotient by it, both with their area polynomials.
     std::unique_ptr<Uni_B1> submodule;
     std::unique_ptr<Uni_B1> quotient;
+    // Subdivision of the cell for the quotient, if it has more than one generator.
+    std::shared_ptr<const Slope_subdivision> quotient_subdivision;
     
     face_data() : subspace_index(0) {}
     
     // Copy constructor
     face_data(const face_data& other) 
-        : subspace_index(other.subspace_index) {
+        : subspace_index(other.subspace_index), slope_polynomial(other.slope_polynomial),
+          quotient_subdivision(other.quotient_subdivision) {
         if (other.submodule){
             submodule = std::make_unique<Uni_B1>(*other.submodule);
         } 
@@ -66,6 +68,8 @@ struct face_data{
     face_data& operator=(const face_data& other) {
         if (this != &other) {
             subspace_index = other.subspace_index;
+            slope_polynomial = other.slope_polynomial;
+            quotient_subdivision = other.quotient_subdivision;
             if (other.submodule){
                 submodule = std::make_unique<Uni_B1>(*other.submodule);
             } 
@@ -94,10 +98,24 @@ using Arrangement = CGAL::Arrangement_2<
     >
 >;
 
+using Point_locator = CGAL::Arr_landmarks_point_location<Arrangement>;
+
 struct Slope_subdivision {
     Arrangement arr;
-    Slope_subdivision() = default;
-    Slope_subdivision(Arrangement arrangement) : arr(std::move(arrangement)) {}
+    // Built once with the arrangement and only queried afterwards, so sweeps on several threads can share it.
+    // It observes arr, so the subdivision cannot be copied or moved and the faces may only change their data.
+    Point_locator locator;
+
+    Slope_subdivision() : locator(arr) {}
+    Slope_subdivision(Arrangement arrangement) : arr(std::move(arrangement)), locator(arr) {}
+    Slope_subdivision(const Slope_subdivision&) = delete;
+    Slope_subdivision& operator=(const Slope_subdivision&) = delete;
+
+    /**
+     * @brief Data of the bounded face containing point. A point on an edge or a vertex gets one of the adjacent faces.
+     * Returns nullptr if point lies outside of all bounded faces.
+     */
+    const face_data* locate(const r2degree& point) const;
 
     void export_to_svg(const std::string& filename, 
         double axes_origin_x = 0.0, 
@@ -115,7 +133,14 @@ Slope_subdivision compute_slope_subdivision(Uni_B1& res,
 std::vector<Point_3> dual_points_polys(const vec<std::array<double,3>>& polynomials);
 
 
-Arrangement subdivision_from_polynomials(const vec<std::array<double,3>>& polynomials);
+/**
+ * @brief Arrangement of the lower envelope of the polynomials, clipped to the box from cell_start to cell_end.
+ * The faces carry no data yet.
+ */
+Arrangement subdivision_from_polynomials(const vec<std::array<double,3>>& polynomials,
+    const r2degree& cell_start,
+    const r2degree& cell_end,
+    const bool info = true);
 
 } // namespace hnf
 
@@ -0,0 +1,49 @@
+#pragma once
+
+#ifndef SUBDIVISION_LOOKUP_HPP
+#define SUBDIVISION_LOOKUP_HPP
+
+#include "hnf_at.hpp"
+#include <memory>
+#include <ostream>
+
+namespace hnf {
+
+// Defined in subdivision.hpp, which pulls in CGAL.
+struct Slope_subdivision;
+
+/**
+ * @brief The HN types of the summand X, with generators at cell_start, for all shifts of its generators inside the cell
+ * up to cell_boundary, as a subdivision of the cell into faces with a fixed scss and quotient.
+ * Returns nullptr if X is unbounded, too large for the Grassmannian table, or the subdivision turned out to be inexact.
+ */
+std::shared_ptr<const Slope_subdivision> compute_cell_subdivision(const Uni_B1& X,
+    const pair<r2degree>& bounds,
+    const r2degree& cell_start,
+    const r2degree& cell_boundary);
+
+/**
+ * @brief Reads the HN filtration at the generator degree cell_start + shift off the subdivision.
+ * Returns false if shift lies outside of the cell, then factors is left empty.
+ */
+bool hnf_from_subdivision(const Slope_subdivision& subdivision,
+    const r2degree& shift,
+    const pair<r2degree>& bounds,
+    HN_factors& factors);
+
+/**
+ * @brief Writes the regions of constant HN type of one local summand over its cell, for the region file format.
+ * Every face is written with its factor, as dimension, area polynomial and intervals, and, if it has one, 
+ * followed by the regions of its quotient. Vertices are relative to cell_start.
+ * A summand with one generator gives a single face. If subdivision is nullptr for a larger summand, 
+ * an empty record is written and false is returned.
+ */
+bool write_summand_regions(std::ostream& ostream,
+    const Uni_B1& summand,
+    const Slope_subdivision* subdivision,
+    const r2degree& cell_start,
+    const r2degree& cell_boundary);
+
+} // namespace hnf
+
+#endif // SUBDIVISION_LOOKUP_HPP
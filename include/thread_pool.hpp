@@ -0,0 +1,174 @@
+#pragma once
+
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <vector>
+#include <queue>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <type_traits>
+#include <deque>
+#include <atomic>
+#include <exception>
+
+namespace hnf {
+
+/**
+ * @brief A fixed-size pool of worker threads which executes tasks in submission order.
+ * Tasks may ask for the index of the worker they run on, so that callers can keep
+ * per-worker resources (an AIDA_functor, a Grassmannian table, ...) in a plain vector.
+ */
+struct Thread_pool {
+
+    explicit Thread_pool(int num_threads);
+    ~Thread_pool();
+
+    Thread_pool(const Thread_pool&) = delete;
+    Thread_pool& operator=(const Thread_pool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    /**
+     * @brief Index in [0, size()) of the worker executing the current task, -1 outside of a pool.
+     */
+    static int worker_index();
+
+    template<typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& task) {
+        using Result = std::invoke_result_t<F>;
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+        std::future<Result> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            tasks.emplace([packaged]() { (*packaged)(); });
+        }
+        queue_cv.notify_one();
+        return result;
+    }
+
+  private:
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> tasks;
+    std::mutex queue_mutex;
+    std::condition_variable queue_cv;
+    bool stopping = false;
+
+    void worker_loop(int index);
+};
+
+/**
+ * @brief A task together with an estimate of its running time. 
+ * The task receives the index of the worker it runs on.
+ */
+struct Prioritised_task {
+    double cost = 0;
+    std::function<void(int)> run;
+};
+
+/**
+ * @brief A pool of worker threads with one deque of tasks per worker.
+ * run_batch deals the tasks, most expensive first, round robin onto the deques. 
+ * Every worker works through its own deque from the front and, once it is empty, 
+ * steals the most expensive remaining task from the front of another deque.
+ * This way the longest tasks start first and no worker idles while others still hold work.
+ */
+struct Work_stealing_pool {
+
+    explicit Work_stealing_pool(int num_threads);
+    ~Work_stealing_pool();
+
+    Work_stealing_pool(const Work_stealing_pool&) = delete;
+    Work_stealing_pool& operator=(const Work_stealing_pool&) = delete;
+
+    int size() const { return static_cast<int>(workers.size()); }
+
+    /**
+     * @brief Runs all tasks and returns once every one of them has finished.
+     * Rethrows the first exception thrown by a task.
+     */
+    void run_batch(std::vector<Prioritised_task>& tasks);
+
+  private:
+    struct Task_deque {
+        std::mutex mutex;
+        std::deque<Prioritised_task> tasks;
+    };
+
+    std::vector<std::unique_ptr<Task_deque>> deques;
+    std::vector<std::thread> workers;
+    std::mutex batch_mutex;
+    std::condition_variable batch_cv;
+    std::condition_variable done_cv;
+    size_t batch_generation = 0;
+    std::atomic<size_t> remaining{0};
+    std::exception_ptr first_error;
+    bool stopping = false;
+
+    bool pop_or_steal(int index, Prioritised_task& task);
+    void worker_loop(int index);
+};
+
+/**
+ * @brief A FIFO queue of fixed capacity between a producer and a consumer thread.
+ * push blocks while the queue is full, pop while it is empty. After close, push drops its item 
+ * and pop drains the remaining items and then returns false.
+ */
+template<typename T>
+struct Bounded_queue {
+
+    explicit Bounded_queue(size_t capacity) : capacity(capacity < 1 ? 1 : capacity) {}
+
+    Bounded_queue(const Bounded_queue&) = delete;
+    Bounded_queue& operator=(const Bounded_queue&) = delete;
+
+    bool push(T item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_full.wait(lock, [this]() { return closed || items.size() < capacity; });
+        if(closed){
+            return false;
+        }
+        items.push_back(std::move(item));
+        not_empty.notify_one();
+        return true;
+    }
+
+    bool pop(T& item) {
+        std::unique_lock<std::mutex> lock(mutex);
+        not_empty.wait(lock, [this]() { return closed || !items.empty(); });
+        if(items.empty()){
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        not_full.notify_one();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            closed = true;
+        }
+        not_full.notify_all();
+        not_empty.notify_all();
+    }
+
+  private:
+    size_t capacity;
+    std::deque<T> items;
+    std::mutex mutex;
+    std::condition_variable not_full;
+    std::condition_variable not_empty;
+    bool closed = false;
+};
+
+int default_num_threads();
+
+} // namespace hnf
+
+#endif // THREAD_POOL_HPP
@@ -0,0 +1,189 @@
+#include "hnf_at.hpp"
+#include "grassmannian_table.hpp"
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+
+using namespace graded_linalg;
+using namespace hnf;
+
+/**
+ * @brief Random uniquely generated presentation with k generators at the origin and relations in [0,1] x [0,1].
+ * If bounded, every generator is also killed at (1,0) and at (0,1), as in random_uni_B1.
+ */
+R2Mat random_presentation(std::mt19937& gen, int k, bool bounded) {
+    std::uniform_real_distribution<double> dist_01(0.0, 1.0);
+    std::uniform_int_distribution<uint64_t> dist_vector(1, (uint64_t(1) << k) - 1);
+    std::uniform_int_distribution<int> dist_num_relations(1, 3 * k);
+    R2Mat X(0, k);
+    int num_relations = dist_num_relations(gen);
+    for (int c = 0; c < num_relations; c++) {
+        uint64_t vector = dist_vector(gen);
+        X.data.emplace_back();
+        for (int row = 0; row < k; row++) {
+            if (vector & (uint64_t(1) << row)) {
+                X.data.back().push_back(row);
+            }
+        }
+        X.col_degrees.push_back({dist_01(gen), dist_01(gen)});
+    }
+    if (bounded) {
+        for (int row = 0; row < k; row++) {
+            X.data.push_back({row});
+            X.data.push_back({row});
+            X.col_degrees.push_back({1.0, 0.0});
+            X.col_degrees.push_back({0.0, 1.0});
+        }
+    }
+    X.row_degrees = vec<r2degree>(k, {0.0, 0.0});
+    X.set_num_cols(X.data.size());
+    f2_minimize(X);
+    return X;
+}
+
+vec<uint64_t> reduced_echelon_form(const SparseMatrix<int>& subspace) {
+    F2_echelon_basis basis;
+    for (const vec<int>& column : subspace.data) {
+        uint64_t vector = 0;
+        for (int row : column) {
+            vector |= uint64_t(1) << row;
+        }
+        basis.add(vector);
+    }
+    return basis.vectors;
+}
+
+bool nearly_equal(double a, double b) {
+    return std::abs(a - b) <= 1e-9 * std::max(std::abs(a), std::abs(b));
+}
+
+/**
+ * @brief Compares the scss found by name with the one of find_scss_bruteforce: slope, dimension and subspace.
+ */
+bool same_scss(const std::string& name, const Uni_B1& expected, const R2Mat& expected_subspace,
+    const Uni_B1& found, const R2Mat& found_subspace) {
+    bool same = nearly_equal(expected.slope_value, found.slope_value)
+        && expected.d1.get_num_rows() == found.d1.get_num_rows()
+        && reduced_echelon_form(expected_subspace) == reduced_echelon_form(found_subspace);
+    if (!same) {
+        std::cout << "  " << name << " found slope " << found.slope_value << " of dimension " << found.d1.get_num_rows()
+            << ", find_scss_bruteforce slope " << expected.slope_value << " of dimension " << expected.d1.get_num_rows() << std::endl;
+    }
+    return same;
+}
+
+/**
+ * @brief Runs every search on X and compares it with find_scss_bruteforce. Returns the number of searches which differ.
+ */
+int compare_searches(const R2Mat& X, const pair<r2degree>& bounds, bool bounded) {
+    int k = X.get_num_rows();
+    int num_mismatches = 0;
+    R2Mat expected_subspace;
+    Uni_B1 expected = find_scss_bruteforce(X, Grassmannian_table::get(k), expected_subspace, bounds);
+
+    R2Mat subspace;
+    Uni_B1 found = find_scss_streaming(X, subspace, bounds);
+    num_mismatches += !same_scss("find_scss_streaming", expected, expected_subspace, found, subspace);
+    found = find_scss_branch_and_bound(X, subspace, bounds);
+    num_mismatches += !same_scss("find_scss_branch_and_bound", expected, expected_subspace, found, subspace);
+
+    Relation_staircase staircase(X, bounds);
+    if (bounded && !staircase.bounded()) {
+        std::cout << "  Relation_staircase does not see that X is bounded" << std::endl;
+        num_mismatches++;
+    }
+    if (staircase.bounded()) {
+        found = find_scss_incremental(X, staircase, subspace, bounds);
+        num_mismatches += !same_scss("find_scss_incremental", expected, expected_subspace, found, subspace);
+        found = find_scss_fixed(X, staircase, subspace, bounds);
+        num_mismatches += !same_scss("find_scss_fixed", expected, expected_subspace, found, subspace);
+        double area = staircase.area(reduced_echelon_form(expected_subspace));
+        if (!nearly_equal(area, expected.d1.get_num_rows() / expected.slope_value)) {
+            std::cout << "  Relation_staircase gives area " << area << " for the scss, its resolution "
+                << expected.d1.get_num_rows() / expected.slope_value << std::endl;
+            num_mismatches++;
+        }
+    }
+
+    // The searches above build submodules and quotients with the F_2 kernels, compare them with the general ones.
+    if (f2_kernel_applies(X)) {
+        R2Mat submodule = X.submodule_generated_by(expected_subspace);
+        submodule.minimize();
+        R2Mat f2_submodule = f2_submodule_generated_by(X, expected_subspace);
+        R2Mat quotient = X;
+        quotient.quotient_by(expected_subspace);
+        R2Mat f2_quotient = X;
+        f2_quotient_by(f2_quotient, expected_subspace);
+        bool same = submodule.get_num_rows() == f2_submodule.get_num_rows()
+            && nearly_equal(Uni_B1(submodule).slope(bounds), Uni_B1(f2_submodule).slope(bounds))
+            && quotient.get_num_rows() == f2_quotient.get_num_rows()
+            && (quotient.get_num_rows() == 0 || nearly_equal(Uni_B1(quotient).area(bounds), Uni_B1(f2_quotient).area(bounds)));
+        if (!same) {
+            std::cout << "  The F_2 kernels give a different submodule or quotient for the scss" << std::endl;
+            num_mismatches++;
+        }
+    }
+    return num_mismatches;
+}
+
+/**
+ * @brief Three subspaces with slopes a < b < c, where a and b as well as b and c are tied but a and c are not.
+ * Only b and c are within the tolerance of the maximum, so b has to win in every order, although a precedes it.
+ */
+bool chained_ties_win_in_every_order() {
+    vec<std::pair<double, uint64_t>> candidates = {
+        {1.0, 0b001}, {1.0 + 0.6 * scss_tolerance, 0b010}, {1.0 + 1.2 * scss_tolerance, 0b100}};
+    bool same = true;
+    do {
+        Scss_candidates scss;
+        for (const auto& [slope, row] : candidates) {
+            scss.offer(slope, vec<uint64_t>{row});
+        }
+        if (scss.winner() != vec<uint64_t>{0b010}) {
+            std::cout << "  Scss_candidates picks a different subspace of three chained ties for another order" << std::endl;
+            same = false;
+        }
+    } while (std::next_permutation(candidates.begin(), candidates.end()));
+    return same;
+}
+
+int main(int argc, char** argv) {
+    int num_samples = 200;
+    unsigned int seed = 1;
+    if (argc > 3) {
+        std::cerr << "Usage: " << argv[0] << " [num_samples] [seed]\n";
+        return 1;
+    }
+    try {
+        if (argc >= 2) {
+            num_samples = std::stoi(argv[1]);
+        }
+        if (argc >= 3) {
+            seed = std::stoul(argv[2]);
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: Invalid integer argument" << std::endl;
+        return 1;
+    }
+
+    int num_failed = chained_ties_win_in_every_order() ? 0 : 1;
+    std::mt19937 gen(seed);
+    std::uniform_int_distribution<int> dist_k(2, max_fixed_dim);
+    pair<r2degree> bounds = {{0.0, 0.0}, {1.1, 1.1}};
+    for (int sample = 0; sample < num_samples; sample++) {
+        bool bounded = sample % 2 == 0;
+        R2Mat X = random_presentation(gen, dist_k(gen), bounded);
+        if (X.get_num_rows() < 2) {
+            continue;
+        }
+        if (compare_searches(X, bounds, bounded) > 0) {
+            std::cout << "Sample " << sample << " (seed " << seed << ") differs:" << std::endl;
+            X.to_stream_r2(std::cout);
+            num_failed++;
+        }
+    }
+    std::cout << "Compared the searches on " << num_samples << " random presentations, "
+        << num_failed << " differ." << std::endl;
+    return num_failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,84 @@
+#include "sky_binary.hpp"
+#include "sky_dictionary.hpp"
+#include <iostream>
+#ifdef SKYSCRAPER_HDF5
+#include "sky_hdf5.hpp"
+#endif
+
+using namespace hnf;
+
+namespace {
+
+bool has_extension(const std::string& path, const std::string& extension) {
+    return path.size() >= extension.size()
+        && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc > 3 || argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <input> <output>\n";
+        std::cerr << "  <input>  : A .sky file in the text, the binary or the dictionary encoded format.\n";
+        std::cerr << "  <output> : (Optional) Path of the converted file (default: <input> with extension .skb or .sky).\n";
+        std::cerr << "             The format follows the extension: .skb binary, .skd dictionary encoded,\n";
+        std::cerr << "             .h5 HDF5, anything else text.\n";
+        return 1;
+    }
+
+    std::string input_file = argv[1];
+    try {
+        bool binary = hnf::Sky_binary_file::is_binary(input_file);
+        bool dictionary = hnf::Sky_dictionary_file::is_dictionary(input_file);
+        std::string output_file;
+        if (argc >= 3) {
+            output_file = argv[2];
+        } else {
+            size_t last_dot = input_file.find_last_of('.');
+            output_file = (last_dot != std::string::npos) ? input_file.substr(0, last_dot) : input_file;
+            output_file += (binary || dictionary) ? ".sky" : ".skb";
+        }
+        if (output_file == input_file) {
+            std::cerr << "Error: Output file would overwrite the input file." << std::endl;
+            return 1;
+        }
+        std::string written;
+        if (has_extension(output_file, ".h5")) {
+#ifdef SKYSCRAPER_HDF5
+            hnf::sky_to_hdf5(input_file, output_file);
+            written = "HDF5";
+#else
+            std::cerr << "Error: sky_convert was built without HDF5, configure with -DWITH_HDF5=ON." << std::endl;
+            return 1;
+#endif
+        } else if (has_extension(output_file, ".skd")) {
+            if (dictionary) {
+                std::cerr << "Error: The input is already dictionary encoded." << std::endl;
+                return 1;
+            }
+            hnf::sky_to_dictionary(input_file, output_file);
+            written = "dictionary encoded";
+        } else if (has_extension(output_file, ".skb")) {
+            if (binary || dictionary) {
+                std::cerr << "Error: Convert binary or dictionary encoded files to text first." << std::endl;
+                return 1;
+            }
+            hnf::sky_text_to_binary(input_file, output_file);
+            written = "binary";
+        } else if (binary) {
+            hnf::sky_binary_to_text(input_file, output_file);
+            written = "text";
+        } else if (dictionary) {
+            hnf::sky_dictionary_to_text(input_file, output_file);
+            written = "text";
+        } else {
+            std::cerr << "Error: The input is already a text file." << std::endl;
+            return 1;
+        }
+        std::cout << "Wrote " << written << " file " << output_file << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
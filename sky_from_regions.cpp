@@ -0,0 +1,54 @@
+#include "region_file.hpp"
+#include <fstream>
+#include <iostream>
+
+using namespace hnf;
+
+int main(int argc, char* argv[]) {
+    if (argc > 3 || argc < 2) {
+        std::cerr << "Usage: " << argv[0] << " <input.skr> <x,y>\n";
+        std::cerr << "  <input.skr> : Path to a region file written by hnf_main --regions.\n";
+        std::cerr << "  <x,y>       : (Optional) Grid resolution of the .sky file (default: 200,200).\n";
+        return 1;
+    }
+
+    std::string input_file = argv[1];
+    int n_x = 200;
+    int n_y = 200;
+    if (argc >= 3) {
+        std::string resolution = argv[2];
+        size_t comma_pos = resolution.find(',');
+        if (comma_pos == std::string::npos) {
+            std::cerr << "Error: Resolution argument must be in the format 'x,y'." << std::endl;
+            return 1;
+        }
+        n_x = std::stoi(resolution.substr(0, comma_pos));
+        n_y = std::stoi(resolution.substr(comma_pos + 1));
+    }
+    if (n_x < 2 || n_y < 2) {
+        std::cerr << "Error: The resolution has to be at least 2 in both directions." << std::endl;
+        return 1;
+    }
+
+    size_t last_dot = input_file.find_last_of('.');
+    std::string output_file = (last_dot != std::string::npos) ? input_file.substr(0, last_dot) : input_file;
+    output_file += "_" + std::to_string(n_x) + "x" + std::to_string(n_y) + ".sky";
+
+    try {
+        hnf::Region_data regions = hnf::regions_from_file(input_file);
+        std::ofstream ostream(output_file);
+        if (!ostream.is_open()) {
+            std::cerr << "Error: Could not open output file: " << output_file << std::endl;
+            return 1;
+        }
+        size_t missed = hnf::rasterise_regions(regions, n_x, n_y, ostream);
+        if (missed > 0) {
+            std::cout << "Warning: " << missed << " grid points lie in regions which could not be resolved exactly." << std::endl;
+        }
+        std::cout << "Wrote " << n_x << "x" << n_y << " grid to " << output_file << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << "\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,249 @@
+#include "f2_matrix.hpp"
+#include <algorithm>
+#include <cassert>
+
+namespace hnf {
+
+namespace {
+
+uint64_t column_mask(const vec<int>& column) {
+    uint64_t mask = 0;
+    for(int row : column){
+        mask |= uint64_t(1) << row;
+    }
+    return mask;
+}
+
+/**
+ * @brief Deletes the bits of v at the positions in removed and shifts the remaining ones down.
+ */
+uint64_t remove_bits(uint64_t v, uint64_t removed) {
+    if(removed == 0){
+        return v;
+    }
+    uint64_t result = 0;
+    int position = 0;
+    for(uint64_t kept = ~removed; kept != 0; kept &= kept - 1){
+        uint64_t bit = kept & -kept;
+        result |= uint64_t((v & bit) != 0) << position;
+        position++;
+    }
+    return result;
+}
+
+struct Graded_relation {
+    r2degree degree;
+    uint64_t vector;
+};
+
+vec<Graded_relation> graded_relations(const R2Mat& X) {
+    vec<Graded_relation> relations;
+    relations.reserve(X.get_num_cols());
+    for(int j = 0; j < X.get_num_cols(); j++){
+        relations.push_back({X.col_degrees[j], column_mask(X.data[j])});
+    }
+    return relations;
+}
+
+/**
+ * @brief Minimal presentation of the module with num_gens generators in degree generator_degree,
+ * whose relations in degree p are relations_at(R_p), where R_p is the span of the vectors in relations of degree <= p.
+ * relations_at has to preserve inclusions. Then the relations in degree p only change on the grid spanned by the
+ * degrees in relations, and a minimal set of relations consists, for every grid point,
+ * of a basis of the relations there modulo the relations at its two lower neighbours.
+ * The relations of the result are sorted lexicographically by degree.
+ */
+template<typename Relations_at>
+R2Mat minimal_presentation(int num_gens,
+    const r2degree& generator_degree,
+    vec<Graded_relation> relations,
+    Relations_at relations_at) {
+    std::sort(relations.begin(), relations.end(), [](const Graded_relation& a, const Graded_relation& b) {
+        return a.degree.second < b.degree.second;
+    });
+    vec<double> xs, ys;
+    for(const Graded_relation& relation : relations){
+        xs.push_back(relation.degree.first);
+        ys.push_back(relation.degree.second);
+    }
+    std::sort(xs.begin(), xs.end());
+    xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+    vec<vec<int>> columns;
+    vec<r2degree> degrees;
+    F2_matrix minimal(num_gens, {});
+    // previous_column[b] holds the relations at (xs[a-1], ys[b]).
+    vec<F2_echelon_basis> previous_column(ys.size());
+    for(size_t a = 0; a < xs.size(); a++){
+        F2_echelon_basis span;
+        F2_echelon_basis below_in_column;
+        size_t next_relation = 0;
+        for(size_t b = 0; b < ys.size(); b++){
+            while(next_relation < relations.size() && relations[next_relation].degree.second <= ys[b]){
+                if(relations[next_relation].degree.first <= xs[a]){
+                    span.add(relations[next_relation].vector);
+                }
+                next_relation++;
+            }
+            F2_echelon_basis current = relations_at(span);
+            F2_echelon_basis below = previous_column[b];
+            for(uint64_t v : below_in_column.vectors){
+                below.add(v);
+            }
+            for(uint64_t v : current.vectors){
+                if(below.add(v)){
+                    minimal.columns.push_back(v);
+                    degrees.emplace_back(xs[a], ys[b]);
+                }
+            }
+            below_in_column = current;
+            previous_column[b] = std::move(current);
+        }
+    }
+
+    R2Mat result(minimal.get_num_cols(), num_gens);
+    result.data = minimal.to_sparse_columns();
+    result.row_degrees = vec<r2degree>(num_gens, generator_degree);
+    result.col_degrees = std::move(degrees);
+    return result;
+}
+
+/**
+ * @brief Minimal presentation of X modulo the generators in killed.
+ */
+R2Mat minimal_quotient(const R2Mat& X, F2_echelon_basis killed) {
+    const r2degree& generator_degree = X.row_degrees[0];
+    vec<Graded_relation> relations = graded_relations(X);
+    for(const Graded_relation& relation : relations){
+        if(Degree_traits<r2degree>::smaller_equal(relation.degree, generator_degree)){
+            killed.add(relation.vector);
+        }
+    }
+    for(Graded_relation& relation : relations){
+        relation.vector = remove_bits(killed.normal_form(relation.vector), killed.pivots);
+    }
+    int num_gens = X.get_num_rows() - killed.dim();
+    return minimal_presentation(num_gens, generator_degree, std::move(relations),
+        [](const F2_echelon_basis& span) -> const F2_echelon_basis& { return span; });
+}
+
+} // namespace
+
+F2_matrix::F2_matrix(const SparseMatrix<int>& M) : num_rows(M.get_num_rows()), columns(M.get_num_cols()) {
+    assert(num_rows <= 64);
+    for(int j = 0; j < M.get_num_cols(); j++){
+        columns[j] = column_mask(M.data[j]);
+    }
+}
+
+vec<vec<int>> F2_matrix::to_sparse_columns() const {
+    vec<vec<int>> result(columns.size());
+    for(size_t j = 0; j < columns.size(); j++){
+        for(uint64_t bits = columns[j]; bits != 0; bits &= bits - 1){
+            result[j].push_back(__builtin_ctzll(bits));
+        }
+    }
+    return result;
+}
+
+int F2_matrix::rank() const {
+    return rank_of(columns.data(), columns.size());
+}
+
+int rank_of(const uint64_t* v, int n) {
+    uint64_t basis[64];
+    int rank = 0;
+    for(int i = 0; i < n; i++){
+        uint64_t x = v[i];
+        // Every basis vector has a leading bit which all earlier ones lack, so this clears it from x if it is set.
+        for(int j = 0; j < rank; j++){
+            x = std::min(x, x ^ basis[j]);
+        }
+        if(x != 0){
+            basis[rank++] = x;
+        }
+    }
+    return rank;
+}
+
+bool F2_echelon_basis::add(uint64_t v) {
+    v = normal_form(v);
+    if(v == 0){
+        return false;
+    }
+    uint64_t pivot = uint64_t(1) << (63 - __builtin_clzll(v));
+    for(uint64_t& b : vectors){
+        b ^= v & -((b & pivot) != 0);
+    }
+    vectors.push_back(v);
+    pivots |= pivot;
+    std::sort(vectors.begin(), vectors.end());
+    return true;
+}
+
+bool f2_kernel_applies(const R2Mat& X) {
+    if(X.get_num_rows() == 0 || X.get_num_rows() > 64){
+        return false;
+    }
+    for(const r2degree& degree : X.row_degrees){
+        if(degree != X.row_degrees[0]){
+            return false;
+        }
+    }
+    return true;
+}
+
+R2Mat f2_submodule_generated_by(const R2Mat& X, const SparseMatrix<int>& subspace) {
+    assert(f2_kernel_applies(X));
+    F2_matrix generators(subspace);
+    int d = generators.get_num_cols();
+    assert(generators.rank() == d);
+    // The relations of the submodule in degree p are the kernel of F_2^d -> F_2^k / R_p.
+    auto kernel = [&generators, d](const F2_echelon_basis& span) {
+        F2_echelon_basis result;
+        // Images modulo span, paired with the combination of generators they come from.
+        vec<std::pair<uint64_t, uint64_t>> reduced;
+        for(int i = 0; i < d; i++){
+            uint64_t image = span.normal_form(generators.columns[i]);
+            uint64_t combination = uint64_t(1) << i;
+            for(const auto& [other_image, other_combination] : reduced){
+                uint64_t mask = -((image & (uint64_t(1) << (63 - __builtin_clzll(other_image)))) != 0);
+                image ^= other_image & mask;
+                combination ^= other_combination & mask;
+            }
+            if(image == 0){
+                result.add(combination);
+            } else {
+                reduced.emplace_back(image, combination);
+            }
+        }
+        return result;
+    };
+    R2Mat result = minimal_presentation(d, X.row_degrees[0], graded_relations(X), kernel);
+    for(const r2degree& degree : result.col_degrees){
+        if(degree == X.row_degrees[0]){
+            // X was not minimal and kills some of the generators already.
+            f2_minimize(result);
+            break;
+        }
+    }
+    return result;
+}
+
+void f2_quotient_by(R2Mat& X, const SparseMatrix<int>& subspace) {
+    assert(f2_kernel_applies(X));
+    F2_echelon_basis killed;
+    for(uint64_t v : F2_matrix(subspace).columns){
+        killed.add(v);
+    }
+    X = minimal_quotient(X, std::move(killed));
+}
+
+void f2_minimize(R2Mat& X) {
+    assert(f2_kernel_applies(X));
+    X = minimal_quotient(X, F2_echelon_basis());
+}
+
+} // namespace hnf
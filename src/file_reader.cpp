@@ -1,69 +1,297 @@
 
 
 #include "file_reader.hpp"
+#include "sky_binary.hpp"
+#include "sky_dictionary.hpp"
+#include "thread_pool.hpp"
 #include <iostream>
-#include <fstream>
-#include <sstream>  
-#include <regex>
 #include <algorithm>
-#include <cmath>
-#include <iomanip>
-#include <cassert>
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace hnf {
 
-    double safe_stod(const std::string& str, const std::string& context) {
-    if (str.empty()) {
-        throw std::runtime_error("Empty string in " + context);
+namespace {
+
+/**
+ * @brief Length of the bar of an interval with the given relations, at the grid point position, 
+ * along the line of the given slope through it. relations holds the x- and y-coordinates in turn.
+ */
+double bar_length(const double* relations, size_t num_relations, const std::pair<double, double>& position, double slope) {
+    // Convert to relative coordinates and find intersections
+    std::vector<std::pair<double, double>> candidates;
+    for (size_t r = 0; r < num_relations; r++) {
+        double rel_x = relations[2*r] - position.first;
+        double rel_y = relations[2*r + 1] - position.second;
+        
+        double int_x, int_y;
+        if (rel_y <= slope * rel_x) {
+            int_x = rel_x;
+            int_y = slope * rel_x;
+        } else {
+            int_y = rel_y;
+            int_x = rel_y / slope;
+        }
+        candidates.push_back({int_x, int_y});
+    }
+    
+    // Choose minimum candidate
+    auto min_candidate = *std::min_element(candidates.begin(), candidates.end());
+    
+    // Calculate length (magnitude)
+    return min_candidate.first;
+}
+
+// File is Sky_binary_file or Sky_dictionary_file.
+template<typename File>
+GridData bars_from_indexed_sky(const std::string& filename) {
+    File file(filename);
+    GridData result;
+    result.n_x = file.n_x;
+    result.n_y = file.n_y;
+    std::cout << "Grid dimensions for filtered landscape: " << result.n_x << " x " << result.n_y << std::endl;
+    result.start_x = file.lower_bound.first;
+    result.start_y = file.lower_bound.second;
+    result.end_x = file.upper_bound.first;
+    result.end_y = file.upper_bound.second;
+    result.step_x = file.grid_step.first;
+    result.step_y = file.grid_step.second;
+    result.slope = result.step_y / result.step_x;
+    result.bars.resize(result.n_x, std::vector<std::vector<Bar>>(result.n_y));
+    for (int j = 0; j < result.n_y; j++) {
+        for (int i = 0; i < result.n_x; i++) {
+            if (!file.has_cell(i, j)) continue;
+            std::pair<double, double> position = file.grid_point(i, j);
+            file.for_each_factor(i, j, [&](double theta, const double* relations, size_t num_relations) {
+                if (num_relations == 0) return;
+                result.bars[i][j].push_back({theta, bar_length(relations, num_relations, position, result.slope)});
+            });
+        }
+    }
+    std::cout << "Loaded landscape grid of size " << result.n_x << " x " << result.n_y << std::endl;
+    return result;
+}
+
+/**
+ * @brief A file mapped read-only into memory, unmapped on destruction.
+ */
+struct Mapped_file {
+    const char* data = nullptr;
+    size_t size = 0;
+
+    explicit Mapped_file(const std::string& filename) {
+        int fd = open(filename.c_str(), O_RDONLY);
+        if (fd == -1) {
+            throw std::runtime_error("Cannot open file: " + filename);
+        }
+        struct stat file_stat;
+        if (fstat(fd, &file_stat) != 0 || file_stat.st_size == 0) {
+            close(fd);
+            throw std::runtime_error("Empty .sky file: " + filename);
+        }
+        size = file_stat.st_size;
+        void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (mapped == MAP_FAILED) {
+            throw std::runtime_error("Cannot map file: " + filename);
+        }
+        // The chunks are read front to back.
+        madvise(mapped, size, MADV_SEQUENTIAL);
+        data = static_cast<const char*>(mapped);
+    }
+
+    ~Mapped_file() {
+        munmap(const_cast<char*>(data), size);
+    }
+
+    Mapped_file(const Mapped_file&) = delete;
+    Mapped_file& operator=(const Mapped_file&) = delete;
+};
+
+/**
+ * @brief Reads the numbers of a line of a .sky file in place, without copying it.
+ */
+struct Line_parser {
+    const char* p;
+    const char* end;
+
+    void skip_blanks() {
+        while (p < end && (*p == ' ' || *p == '\t')) p++;
+    }
+
+    [[noreturn]] void fail(const std::string& expected) const {
+        throw std::runtime_error("Expected " + expected + " in .sky line at: " + std::string(p, end));
+    }
+
+    template<typename T>
+    T number(const char* context) {
+        skip_blanks();
+        T value;
+        auto [next, error] = std::from_chars(p, end, value);
+        if (error != std::errc()) {
+            fail(context);
+        }
+        p = next;
+        return value;
+    }
+
+    void expect(char c) {
+        skip_blanks();
+        if (p == end || *p != c) {
+            fail(std::string("'") + c + "'");
+        }
+        p++;
+    }
+
+    // Reads "(x, y)" or "(x;y)".
+    std::pair<double, double> point(char separator, const char* context) {
+        expect('(');
+        double x = number<double>(context);
+        expect(separator);
+        double y = number<double>(context);
+        expect(')');
+        return {x, y};
+    }
+};
+
+/**
+ * @brief Calls f(begin, end) for every non-empty line in [begin, end), without line break and surrounding blanks.
+ * Stops after max_lines lines and returns the position after the last line read.
+ */
+template<typename F>
+const char* for_each_line(const char* begin, const char* end, F f, size_t max_lines = SIZE_MAX) {
+    size_t lines = 0;
+    while (begin < end && lines < max_lines) {
+        const char* line_break = static_cast<const char*>(std::memchr(begin, '\n', end - begin));
+        const char* line_end = line_break == nullptr ? end : line_break;
+        const char* next = line_break == nullptr ? end : line_break + 1;
+        while (begin < line_end && (*begin == ' ' || *begin == '\t')) begin++;
+        while (line_end > begin && (line_end[-1] == ' ' || line_end[-1] == '\t' || line_end[-1] == '\r')) line_end--;
+        if (begin < line_end) {
+            f(begin, line_end);
+            lines++;
+        }
+        begin = next;
+    }
+    return begin;
+}
+
+// The first position at or after position which starts a grid point line "G,".
+const char* next_grid_line(const char* position, const char* begin, const char* end) {
+    if (position > begin && position[-1] != '\n') {
+        const char* line_break = static_cast<const char*>(std::memchr(position, '\n', end - position));
+        position = line_break == nullptr ? end : line_break + 1;
     }
-    try {
-        return std::stod(str);
-    } catch (const std::exception& e) {
-        std::cerr << "stod failed at " << context << ": '" << str << "'" << std::endl;
-        throw;
+    while (position < end) {
+        const char* line = position;
+        while (line < end && (*line == ' ' || *line == '\t')) line++;
+        if (end - line >= 2 && line[0] == 'G' && line[1] == ',') {
+            return position;
+        }
+        const char* line_break = static_cast<const char*>(std::memchr(position, '\n', end - position));
+        position = line_break == nullptr ? end : line_break + 1;
     }
+    return end;
+}
+
+/**
+ * @brief The bars of the cells in one chunk of a text .sky file, in the order of the file.
+ */
+struct Chunk_bars {
+    std::vector<std::pair<std::pair<int, int>, std::vector<Bar>>> cells;
+};
+
+Chunk_bars parse_chunk(const char* begin, const char* end, const GridData& grid) {
+    Chunk_bars chunk;
+    std::pair<double, double> current_position;
+    std::vector<double> relations;
+    for_each_line(begin, end, [&](const char* line, const char* line_end) {
+        Line_parser parser{line, line_end};
+        if (line_end - line >= 2 && line[0] == 'G' && line[1] == ',') {
+            parser.p += 2;
+            int i = parser.number<int>("grid index");
+            parser.expect(',');
+            int j = parser.number<int>("grid index");
+            parser.expect(',');
+            if (i < 0 || i >= grid.n_x || j < 0 || j >= grid.n_y) {
+                throw std::runtime_error("Grid point (" + std::to_string(i) + ", " + std::to_string(j) + ") outside of the grid");
+            }
+            current_position = parser.point(',', "grid point coordinate");
+            chunk.cells.push_back({{i, j}, {}});
+            return;
+        }
+        if (chunk.cells.empty()) {
+            throw std::runtime_error("Stable factor before the first grid point: " + std::string(line, line_end));
+        }
+        double theta = parser.number<double>("slope");
+        // Relations, as x- and y-coordinates in turn
+        relations.clear();
+        while (parser.p < parser.end) {
+            parser.expect(',');
+            auto relation = parser.point(';', "relation coordinate");
+            relations.push_back(relation.first);
+            relations.push_back(relation.second);
+        }
+        if (relations.empty()) return;
+        double length = bar_length(relations.data(), relations.size() / 2, current_position, grid.slope);
+        chunk.cells.back().second.push_back({theta, length});
+    });
+    return chunk;
 }
 
+} // namespace
+
 GridData bars_from_sky(const std::string& filename) {
-    std::ifstream file(filename);
-    static char buffer[1 << 20]; // 1 MB buffer
-    file.rdbuf()->pubsetbuf(buffer, sizeof(buffer));
-    if (!file.is_open()) {
-        throw std::runtime_error("Cannot open file: " + filename);
+    if (Sky_binary_file::is_binary(filename)) {
+        return bars_from_indexed_sky<Sky_binary_file>(filename);
     }
-    
-    GridData result;
-    std::string line;
-    
-    // Line 1: Must be "HNF"
-    std::getline(file, line);
-    if (line.find("HNF") == std::string::npos) {
-        throw std::runtime_error("First line must be 'HNF'");
+    if (Sky_dictionary_file::is_dictionary(filename)) {
+        return bars_from_indexed_sky<Sky_dictionary_file>(filename);
     }
-    
-    // Line 2: Grid dimensions
-    std::getline(file, line);
-    std::sscanf(line.c_str(), "%d,%d", &result.n_x, &result.n_y);
-    
-    std::cout << "Grid dimensions for filtered landscape: " << result.n_x << " x " << result.n_y << std::endl;
+    Mapped_file file(filename);
+    const char* end = file.data + file.size;
 
-    // Line 3: Lattice info - extract coordinates
-    std::getline(file, line);
-    std::regex coord_regex(R"(\((-?[0-9.eE+-]+),\s*(-?[0-9.eE+-]+)\))");
-    auto coords_begin = std::sregex_iterator(line.begin(), line.end(), coord_regex);
-    auto coords_end = std::sregex_iterator();
-    
-    std::vector<std::pair<double, double>> coords;
-    for (auto it = coords_begin; it != coords_end; ++it) {
-        double x = safe_stod((*it)[1], "lattice vector x-coordinate");
-        double y = safe_stod((*it)[2], "lattice vector y-coordinate");
-        coords.push_back({x, y});
+    GridData result;
+    int line_number = 0;
+    std::pair<double, double> coords[3];
+    const char* body = for_each_line(file.data, end, [&](const char* line, const char* line_end) {
+        Line_parser parser{line, line_end};
+        line_number++;
+        if (line_number == 1) {
+            // Line 1: Must be "HNF"
+            if (std::string(line, line_end).find("HNF") == std::string::npos) {
+                throw std::runtime_error("First line must be 'HNF'");
+            }
+        } else if (line_number == 2) {
+            // Line 2: Grid dimensions
+            result.n_x = parser.number<int>("grid dimension");
+            parser.expect(',');
+            result.n_y = parser.number<int>("grid dimension");
+        } else {
+            // Line 3: Lattice info - lower bound, upper bound and grid step
+            for (auto& coord : coords) {
+                while (parser.p < parser.end && *parser.p != '(') parser.p++;
+                if (parser.p == parser.end) {
+                    throw std::runtime_error("Expected 3 coordinate pairs");
+                }
+                coord = parser.point(',', "lattice coordinate");
+            }
+        }
+    }, 3);
+    if (line_number < 3) {
+        throw std::runtime_error("Incomplete header in .sky file: " + filename);
     }
-    
-    if (coords.size() < 3) {
-        throw std::runtime_error("Expected 3 coordinate pairs");
+    if (result.n_x < 1 || result.n_y < 1) {
+        throw std::runtime_error("Malformed grid dimensions in .sky file: " + filename);
     }
-    
+    std::cout << "Grid dimensions for filtered landscape: " << result.n_x << " x " << result.n_y << std::endl;
+
     // Extract lattice vectors
     result.start_x = coords[0].first;
     result.start_y = coords[0].second;
@@ -72,89 +300,51 @@ GridData bars_from_sky(const std::string& filename) {
     result.step_x = coords[2].first;
     result.step_y = coords[2].second;
     result.slope = result.step_y / result.step_x;
-    
+
     // Initialize bars grid
     result.bars.resize(result.n_x, std::vector<std::vector<Bar>>(result.n_y));
-    
-    // Process grid points and stable modules
-    std::pair<double, double> current_position;
-    int i = -1, j = -1;
-    
-    while (std::getline(file, line)) {
-        // Trim whitespace
-        line.erase(0, line.find_first_not_of(" \t\r\n"));
-        line.erase(line.find_last_not_of(" \t\r\n") + 1);
-        
-        if (line.empty()) continue;
-        
-        if (line.substr(0, 2) == "G,") {
-            size_t first_comma = line.find(',', 2);
-            size_t second_comma = line.find(',', first_comma + 1);
-            size_t paren_open = line.find('(', second_comma);
-            size_t coord_comma = line.find(',', paren_open);
-            size_t paren_close = line.find(')', coord_comma);
-            
-            i = std::stoi(line.substr(2, first_comma - 2));
-            j = std::stoi(line.substr(first_comma + 1, second_comma - first_comma - 1));
-            current_position.first = safe_stod(line.substr(paren_open + 1, coord_comma - paren_open - 1), "grid point x-coordinate");
-            current_position.second = safe_stod(line.substr(coord_comma + 1, paren_close - coord_comma - 1), "grid point y-coordinate");
-        } else {
 
-            std::istringstream iss(line);
-            std::string token;
-            
-            // First token is slope
-            std::getline(iss, token, ',');
-            double theta = safe_stod(token, "slope");
-            
-            // Parse relations
-            std::vector<std::pair<double, double>> relations;
-            while (std::getline(iss, token, ',')) {
-                size_t paren_open = token.find('(');
-                size_t semicolon = token.find(';');
-                size_t paren_close = token.find(')');
-                
-                if (paren_open != std::string::npos && 
-                    semicolon != std::string::npos && 
-                    paren_close != std::string::npos) {
-                    double x = safe_stod(token.substr(paren_open + 1, semicolon - paren_open - 1), "relation x-coordinate");
-                    double y = safe_stod(token.substr(semicolon + 1, paren_close - semicolon - 1), "relation y-coordinate");
-                    relations.push_back({x, y});
-                } else {
-                    throw std::runtime_error("Malformed relation: " + token);
-                }
-            }
-            
-            if (relations.empty()) continue;
-            
-            // Convert to relative coordinates and find intersections
-            std::vector<std::pair<double, double>> candidates;
-            for (const auto& [x, y] : relations) {
-                double rel_x = x - current_position.first;
-                double rel_y = y - current_position.second;
-                
-                double int_x, int_y;
-                if (rel_y <= result.slope * rel_x) {
-                    int_x = rel_x;
-                    int_y = result.slope * rel_x;
-                } else {
-                    int_y = rel_y;
-                    int_x = rel_y / result.slope;
-                }
-                candidates.push_back({int_x, int_y});
+    // Chunks of about 4 MB, cut at grid point lines, so that every cell lies in one chunk.
+    const size_t chunk_size = size_t(1) << 22;
+    size_t num_chunks = std::max<size_t>(1, (end - body) / chunk_size);
+    std::vector<const char*> boundaries = {body};
+    for (size_t c = 1; c < num_chunks; c++) {
+        const char* boundary = next_grid_line(std::max(body + c * ((end - body) / num_chunks), boundaries.back()), body, end);
+        if (boundary > boundaries.back()) {
+            boundaries.push_back(boundary);
+        }
+    }
+    boundaries.push_back(end);
+
+    std::vector<Chunk_bars> chunks(boundaries.size() - 1);
+    if (chunks.size() == 1) {
+        chunks[0] = parse_chunk(boundaries[0], boundaries[1], result);
+    } else {
+        Thread_pool pool(std::min<int>(default_num_threads(), static_cast<int>(chunks.size())));
+        std::vector<std::future<void>> parsed;
+        for (size_t c = 0; c < chunks.size(); c++) {
+            parsed.push_back(pool.submit([&, c]() {
+                chunks[c] = parse_chunk(boundaries[c], boundaries[c + 1], result);
+            }));
+        }
+        for (auto& future : parsed) {
+            future.get();
+        }
+    }
+
+    // In the order of the file, as if it was read line by line.
+    for (auto& chunk : chunks) {
+        for (auto& [cell, bars] : chunk.cells) {
+            auto& target = result.bars[cell.first][cell.second];
+            if (target.empty()) {
+                target = std::move(bars);
+            } else {
+                target.insert(target.end(), bars.begin(), bars.end());
             }
-            
-            // Choose minimum candidate
-            auto min_candidate = *std::min_element(candidates.begin(), candidates.end());
-            
-            // Calculate length (magnitude)
-            double length = min_candidate.first;
-            result.bars[i][j].push_back({theta, length});
         }
     }
-    // result.n_y -= 30; // Adjust for extra grid points
     std::cout << "Loaded landscape grid of size " << result.n_x << " x " << result.n_y << std::endl;
     return result;
 }
 
-} // namespace hnf
\ No newline at end of file
+} // namespace hnf
@@ -0,0 +1,357 @@
+#include "grassmannian_table.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace hnf {
+
+namespace {
+
+// File layout, all integers little endian as written by the host:
+//   magic "SKYGRASS", uint32 version, uint32 largest k in the file,
+//   uint64 offset of the block of k for k = 0..max_dim (0 if k is not in the file),
+//   block of k: for d = 0..k a uint64 count of subspaces, followed by each subspace
+//   as a uint32 number of columns and one uint64 bitmask of rows per column.
+const char table_magic[8] = {'S','K','Y','G','R','A','S','S'};
+const uint32_t table_version = 1;
+const size_t header_size = sizeof(table_magic) + 2*sizeof(uint32_t) + (Grassmannian_table::max_dim + 1)*sizeof(uint64_t);
+
+template<typename T>
+T read_value(const char* data, size_t& position) {
+    T value;
+    std::memcpy(&value, data + position, sizeof(T));
+    position += sizeof(T);
+    return value;
+}
+
+/**
+ * @brief Number of subspaces of dimension d of F_2^k, the Gaussian binomial coefficient.
+ */
+uint64_t num_subspaces(int k, int d) {
+    if(d < 0 || d > k){
+        return 0;
+    }
+    if(d == 0 || d == k){
+        return 1;
+    }
+    return num_subspaces(k - 1, d - 1) + (uint64_t(1) << d) * num_subspaces(k - 1, d);
+}
+
+/**
+ * @brief True if the block of k at position lies inside the first size bytes of data
+ * and lists, for every d, at most as many subspaces as F_2^k has, each with d nonzero columns over k rows.
+ */
+bool valid_block(const char* data, size_t size, int k, size_t position) {
+    const uint64_t row_mask = (uint64_t(1) << k) - 1;
+    for(int d = 0; d <= k; d++){
+        if(size - position < sizeof(uint64_t)){
+            return false;
+        }
+        uint64_t count = read_value<uint64_t>(data, position);
+        if(count > num_subspaces(k, d)){
+            return false;
+        }
+        for(uint64_t s = 0; s < count; s++){
+            if(size - position < sizeof(uint32_t) + d * sizeof(uint64_t)
+                || read_value<uint32_t>(data, position) != static_cast<uint32_t>(d)){
+                return false;
+            }
+            for(int c = 0; c < d; c++){
+                uint64_t column = read_value<uint64_t>(data, position);
+                if(column == 0 || (column & ~row_mask) != 0){
+                    return false;
+                }
+            }
+        }
+    }
+    return true;
+}
+
+template<typename T>
+void write_value(std::ostream& out, T value) {
+    out.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+} // namespace
+
+struct Grassmannian_table::Mapped_file {
+    const char* data = nullptr;
+    size_t size = 0;
+    uint32_t max_k = 0;
+    vec<uint64_t> offsets;
+
+    ~Mapped_file() {
+        if(data != nullptr){
+            munmap(const_cast<char*>(data), size);
+        }
+    }
+};
+
+Grassmannian_table::Grassmannian_table() = default;
+Grassmannian_table::~Grassmannian_table() = default;
+
+Grassmannian_table& Grassmannian_table::instance() {
+    static Grassmannian_table table;
+    return table;
+}
+
+const vec<vec<SparseMatrix<int>>>& Grassmannian_table::get(int k) {
+    if(k < 1 || k > max_dim){
+        std::cerr << "  The Grassmannian table only holds subspaces of F_2^k for k up to " << max_dim
+                  << ", but dimension " << k << " was requested." << std::endl;
+        std::exit(1);
+    }
+    Grassmannian_table& table = instance();
+    std::call_once(table.built[k], [&table, k]() { table.build(k); });
+    return *table.subspaces[k];
+}
+
+void Grassmannian_table::build(int k) {
+    auto result = std::make_unique<vec<vec<SparseMatrix<int>>>>();
+    if(mapped && static_cast<int>(mapped->max_k) >= k && mapped->offsets[k] != 0){
+        size_t position = mapped->offsets[k];
+        result->resize(k + 1);
+        for(int d = 0; d <= k; d++){
+            uint64_t count = read_value<uint64_t>(mapped->data, position);
+            (*result)[d].reserve(count);
+            for(uint64_t s = 0; s < count; s++){
+                uint32_t num_cols = read_value<uint32_t>(mapped->data, position);
+                SparseMatrix<int> subspace(num_cols, k);
+                for(uint32_t c = 0; c < num_cols; c++){
+                    uint64_t column = read_value<uint64_t>(mapped->data, position);
+                    for(int row = 0; row < k; row++){
+                        if(column & (uint64_t(1) << row)){
+                            subspace.data[c].push_back(row);
+                        }
+                    }
+                }
+                (*result)[d].emplace_back(std::move(subspace));
+            }
+        }
+    } else {
+        auto all_subspaces = sparse_seperated_grassmannians<int>(k);
+        *result = std::move(all_subspaces[k-1]);
+    }
+    subspaces[k] = std::move(result);
+}
+
+bool Grassmannian_table::attach(const std::string& path) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd == -1){
+        return false;
+    }
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < header_size){
+        close(fd);
+        return false;
+    }
+    auto file = std::make_unique<Mapped_file>();
+    file->size = file_stat.st_size;
+    void* data = mmap(nullptr, file->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED){
+        return false;
+    }
+    file->data = static_cast<const char*>(data);
+
+    size_t position = sizeof(table_magic);
+    uint32_t version = read_value<uint32_t>(file->data, position);
+    file->max_k = read_value<uint32_t>(file->data, position);
+    if(std::memcmp(file->data, table_magic, sizeof(table_magic)) != 0 || version != table_version
+        || file->max_k > static_cast<uint32_t>(max_dim)){
+        std::cerr << "  " << path << " is not a Grassmannian table of this version, ignoring it." << std::endl;
+        return false;
+    }
+    // Every block is checked once here, build decodes them without further checks.
+    for(int k = 0; k <= max_dim; k++){
+        uint64_t offset = read_value<uint64_t>(file->data, position);
+        bool in_file = k >= 1 && k <= static_cast<int>(file->max_k);
+        if(in_file && (offset < header_size || offset >= file->size
+            || !valid_block(file->data, file->size, k, offset))){
+            std::cerr << "  " << path << " is truncated or corrupt, ignoring it." << std::endl;
+            return false;
+        }
+        file->offsets.push_back(in_file ? offset : 0);
+    }
+    instance().mapped = std::move(file);
+    return true;
+}
+
+void Grassmannian_table::save(const std::string& path, int k) {
+    k = std::min(k, static_cast<int>(max_dim));
+    vec<uint64_t> offsets(max_dim + 1, 0);
+    std::ostringstream blocks;
+    for(int n = 1; n <= k; n++){
+        offsets[n] = header_size + static_cast<uint64_t>(blocks.tellp());
+        const auto& grassmannians = get(n);
+        for(const auto& grassmannian : grassmannians){
+            write_value<uint64_t>(blocks, grassmannian.size());
+            for(const SparseMatrix<int>& subspace : grassmannian){
+                write_value<uint32_t>(blocks, subspace.get_num_cols());
+                for(const auto& column : subspace.data){
+                    uint64_t mask = 0;
+                    for(int row : column){
+                        mask |= uint64_t(1) << row;
+                    }
+                    write_value<uint64_t>(blocks, mask);
+                }
+            }
+        }
+    }
+
+    // Write to a temporary file first, the old table might still be mapped.
+    std::string temporary_path = path + ".tmp";
+    std::ofstream out(temporary_path, std::ios::binary);
+    if(!out){
+        std::cerr << "  Could not write the Grassmannian table to " << path << std::endl;
+        return;
+    }
+    out.write(table_magic, sizeof(table_magic));
+    write_value<uint32_t>(out, table_version);
+    write_value<uint32_t>(out, k);
+    for(uint64_t offset : offsets){
+        write_value<uint64_t>(out, offset);
+    }
+    out << blocks.str();
+    out.close();
+    if(std::rename(temporary_path.c_str(), path.c_str()) != 0){
+        std::cerr << "  Could not write the Grassmannian table to " << path << std::endl;
+    }
+}
+
+int Grassmannian_table::loaded_dim() {
+    Grassmannian_table& table = instance();
+    int k = 0;
+    for(int n = 1; n <= max_dim; n++){
+        if(table.subspaces[n]){
+            k = n;
+        }
+    }
+    return k;
+}
+
+int Grassmannian_table::file_dim() {
+    Grassmannian_table& table = instance();
+    return table.mapped ? static_cast<int>(table.mapped->max_k) : 0;
+}
+
+Grassmannian_enumerator::Grassmannian_enumerator(int k, int d) : k(k), d(d), pivots(d), rows(d) {
+    assert(k <= 64);
+    if(d < 0 || d > k){
+        done = true;
+        return;
+    }
+    for(int r = 0; r < d; r++){
+        pivots[r] = r;
+    }
+    set_free_entries();
+}
+
+void Grassmannian_enumerator::set_free_entries() {
+    free_entries.clear();
+    uint64_t pivot_columns = 0;
+    for(int p : pivots){
+        pivot_columns |= uint64_t(1) << p;
+    }
+    for(int r = 0; r < d; r++){
+        for(int q = pivots[r] + 1; q < k; q++){
+            if(!(pivot_columns & (uint64_t(1) << q))){
+                free_entries.emplace_back(r, q);
+            }
+        }
+    }
+    // One more bit than there are free entries, it is set when the counter wraps around.
+    free_pattern.assign(free_entries.size() / 64 + 1, 0);
+}
+
+bool Grassmannian_enumerator::pattern_is_zero() const {
+    for(uint64_t word : free_pattern){
+        if(word != 0){
+            return false;
+        }
+    }
+    return true;
+}
+
+void Grassmannian_enumerator::increment_pattern() {
+    for(uint64_t& word : free_pattern){
+        if(++word != 0){
+            break;
+        }
+    }
+    size_t n = free_entries.size();
+    if((free_pattern[n / 64] >> (n % 64)) & 1){
+        std::fill(free_pattern.begin(), free_pattern.end(), 0);
+    }
+}
+
+bool Grassmannian_enumerator::next_pivots() {
+    // Next d-subset of {0,..,k-1} in lexicographic order.
+    int r = d - 1;
+    while(r >= 0 && pivots[r] == k - d + r){
+        r--;
+    }
+    if(r < 0){
+        return false;
+    }
+    pivots[r]++;
+    for(int s = r + 1; s < d; s++){
+        pivots[s] = pivots[s-1] + 1;
+    }
+    set_free_entries();
+    return true;
+}
+
+bool Grassmannian_enumerator::advance() {
+    if(done){
+        return false;
+    }
+    if(!started || pattern_is_zero()){
+        if(started && !next_pivots()){
+            done = true;
+            return false;
+        }
+        started = true;
+        for(int r = 0; r < d; r++){
+            rows[r] = uint64_t(1) << pivots[r];
+        }
+        change = {-1, -1};
+    } else {
+        // The i-th Gray code differs from the (i-1)-th in the lowest set bit of i.
+        size_t word = 0;
+        while(free_pattern[word] == 0){
+            word++;
+        }
+        const auto& entry = free_entries[64 * word + __builtin_ctzll(free_pattern[word])];
+        rows[entry.first] ^= uint64_t(1) << entry.second;
+        change = entry;
+    }
+    increment_pattern();
+    return true;
+}
+
+bool Grassmannian_enumerator::next(SparseMatrix<int>& subspace) {
+    if(!advance()){
+        return false;
+    }
+    subspace = SparseMatrix<int>(d, k);
+    for(int r = 0; r < d; r++){
+        for(int q = pivots[r]; q < k; q++){
+            if(rows[r] & (uint64_t(1) << q)){
+                subspace.data[r].push_back(q);
+            }
+        }
+    }
+    return true;
+}
+
+} // namespace hnf
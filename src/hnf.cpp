@@ -62,6 +62,16 @@ r2degree get_grid_step(const r2degree& lower_bound, const r2degree& upper_bound,
     return {x_step, y_step};
 }
 
+vec<double> grid_row_coordinates(const r2degree& lower_bound, const r2degree& grid_step, const int& grid_length_x) {
+    vec<double> xs(grid_length_x);
+    double x = lower_bound.first - grid_step.first*0.999;
+    for(int i = 0; i < grid_length_x; i++){
+        x += grid_step.first;
+        xs[i] = x;
+    }
+    return xs;
+}
+
 void write_slopes_to_csv(const vec<vec<double>>& slopes,
         const vec<r2degree>& grid_points,
         const std::string& filename) {
@@ -150,74 +160,678 @@ void compare_slopes_test(r2degree current_grid_degree,
 
 }
 
+namespace {
+
+void insert_sorted(vec<int>& active, int k) {
+    active.insert(std::lower_bound(active.begin(), active.end(), k), k);
+}
+
+/**
+ * @brief True if no relation degree of X has a coordinate between the generator degrees from and to,
+ * so that the area polynomials computed at from still hold at to.
+ */
+bool in_same_relation_cell(const R2Mat& X, const r2degree& from, const r2degree& to) {
+    for(const r2degree& degree : X.col_degrees){
+        if((degree.first <= from.first) != (degree.first <= to.first)
+            || (degree.second <= from.second) != (degree.second <= to.second)){
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+void update_HNF_rows_at_y_level(
+    const r2degree& current_grid_degree,
+    Grid_sweep_state& state,
+    aida::AIDA_functor& decomposer,
+    const pair<r2degree>& slope_bounds) {
+
+    for(int k : state.active_cells){
+        state.grid_locations[k].first = -1;
+    }
+    state.active_cells.clear();
+
+    while(!state.y_crossings.empty() && state.y_crossings.top().first <= current_grid_degree.second){
+        int k = state.y_crossings.top().second;
+        state.y_crossings.pop();
+        R2Mat& M = *state.summands[k];
+        pair<int>& grid_location = state.grid_locations[k];
+        Dynamic_HNF* prefetched_row = state.prefetched ? state.prefetched->find(k) : nullptr;
+        if(prefetched_row){
+            grid_location.first = -1;
+            advance_local_row(current_grid_degree, M, grid_location.second);
+            assert(prefetched_row->row_index == grid_location.second);
+            state.local_grid_row_data[k] = std::move(*prefetched_row);
+        } else {
+            update_HNF_row_of_summand(current_grid_degree, M, grid_location, state.local_grid_row_data[k], decomposer, slope_bounds);
+        }
+        int next_y = grid_location.second + 1;
+        if(next_y < static_cast<int>(M.y_grid.size())){
+            state.y_crossings.push({M.y_grid[next_y], k});
+        }
+        if(state.is_interval[k]){
+            state.intervals.update_cells(k, state.local_grid_row_data[k]);
+        }
+        // A summand becomes active once the sweep has reached its first row of local cells and stays active,
+        // since its cells are only decomposed when they are visited.
+        auto position = std::lower_bound(state.active_rows.begin(), state.active_rows.end(), k);
+        bool active = position != state.active_rows.end() && *position == k;
+        if(!active && grid_location.second != -1){
+            state.active_rows.insert(position, k);
+        }
+    }
+
+    state.x_crossings = Grid_sweep_state::Crossing_queue();
+    for(int k : state.active_rows){
+        if(!state.is_interval[k]){
+            state.x_crossings.push({state.summands[k]->x_grid[0], k});
+        }
+    }
+}
+
+void Interval_row::update_cells(int k, const Dynamic_HNF& local_row_data) {
+    cell_relations[k].assign(local_row_data.indecomposable_summands.size(), vec<r2degree>());
+    // A prefetched row arrives with its cells already decomposed.
+    for(size_t x = 0; x < local_row_data.computed.size(); x++){
+        if(local_row_data.computed[x]){
+            reduce_cell(k, local_row_data, x);
+        }
+    }
+}
+
+void Interval_row::compute_cell(int k, Dynamic_HNF& local_row_data, R2Mat& M, int x, aida::AIDA_functor& decomposer) {
+    if(local_row_data.compute_cell(decomposer, M, x)){
+        reduce_cell(k, local_row_data, x);
+    }
+}
+
+void Interval_row::reduce_cell(int k, const Dynamic_HNF& local_row_data, int x) {
+    const vec<Uni_B1>& local_summands = local_row_data.indecomposable_summands[x];
+    if(local_summands.empty()){
+        return;
+    }
+    assert(local_summands.size() == 1 && local_summands[0].d1.get_num_rows() == 1);
+    // The reduction only compares the degrees of the relations, so it can be done once for the whole cell.
+    R2Mat reduced = local_summands[0].d1;
+    reduced.column_reduction_graded();
+    cell_relations[k][x] = reduced.col_degrees;
+}
+
+void Interval_row::evaluate_row(const vec<int>& active,
+    const vec<R2Mat*>& all_summands,
+    const vec<pair<int>>& grid_locations,
+    vec<Dynamic_HNF>& local_grid_row_data,
+    const vec<double>& xs,
+    double y,
+    const pair<r2degree>& slope_bounds,
+    aida::AIDA_functor& decomposer) {
+
+    grid_length_x = xs.size();
+    summands.clear();
+    for(int k : active){
+        if(cell_relations[k].size() > 0 && all_summands[k]->get_num_rows() == 1){
+            summands.push_back(k);
+        }
+    }
+    slopes.assign(summands.size() * grid_length_x, std::numeric_limits<double>::quiet_NaN());
+    relations.assign(summands.size() * grid_length_x, nullptr);
+
+    double range_area = (slope_bounds.second.first - slope_bounds.first.first) * (slope_bounds.second.second - slope_bounds.first.second);
+    vec<double> shifts(grid_length_x);
+    for(size_t s = 0; s < summands.size(); s++){
+        int k = summands[s];
+        R2Mat& M = *all_summands[k];
+        const vec<vec<Uni_B1>>& cells = local_grid_row_data[k].indecomposable_summands;
+        double shift_y = y - M.y_grid[grid_locations[k].second];
+        double* row_slopes = slopes.data() + s * grid_length_x;
+        const vec<r2degree>** row_relations = relations.data() + s * grid_length_x;
+
+        // Walk through the local cells along the row, the grid points of a cell form a contiguous range.
+        int i = std::lower_bound(xs.begin(), xs.end(), M.x_grid[0]) - xs.begin();
+        for(int x = 0; x < static_cast<int>(M.x_grid.size()) && i < grid_length_x; x++){
+            int i_end = grid_length_x;
+            if(x + 1 < static_cast<int>(M.x_grid.size())){
+                i_end = std::lower_bound(xs.begin() + i, xs.end(), M.x_grid[x + 1]) - xs.begin();
+            }
+            if(i < i_end){
+                compute_cell(k, local_grid_row_data[k], M, x, decomposer);
+            }
+            if(!cells[x].empty()){
+                const std::array<double, 3>& p = cells[x][0].area_polynomial;
+                double corner_x = M.x_grid[x];
+                for(int l = i; l < i_end; l++){
+                    shifts[l] = xs[l] - corner_x;
+                }
+                // Same expression as Uni_B1::evaluate_slope_polynomial with k = 1, without dependencies between iterations.
+                for(int l = i; l < i_end; l++){
+                    row_slopes[l] = 1.0 / (p[0] + p[1]*shifts[l] + p[2]*shift_y + 1.0*shifts[l]*shift_y/range_area);
+                }
+                for(int l = i; l < i_end; l++){
+                    row_relations[l] = &cell_relations[k][x];
+                }
+            }
+            i = i_end;
+        }
+    }
+}
+
+void update_grid_locations_x(const r2degree& current_grid_degree, Grid_sweep_state& state) {
+    while(!state.x_crossings.empty() && state.x_crossings.top().first <= current_grid_degree.first){
+        int k = state.x_crossings.top().second;
+        state.x_crossings.pop();
+        R2Mat& M = *state.summands[k];
+        int& local_x = state.grid_locations[k].first;
+        if(local_x == -1){
+            insert_sorted(state.active_cells, k);
+        }
+        update_grid_location_x_of_summand(current_grid_degree, M, local_x, k);
+        if(local_x + 1 < static_cast<int>(M.x_grid.size())){
+            state.x_crossings.push({M.x_grid[local_x + 1], k});
+        }
+    }
+}
+
+void process_grid_cell(
+    int i, int j,
+    const r2degree& current_grid_degree,
+    Grid_sweep_state& state,
+    const pair<r2degree>& slope_bounds,
+    aida::AIDA_functor& decomposer) {
+    for(int k : state.active_cells){
+        process_summand_at_grid_cell(i, j, k, current_grid_degree, *state.summands[k], state.grid_locations[k], state.local_grid_row_data[k], 
+            state.composition_factors, state.grid_ind_dimensions, slope_bounds, decomposer);
+    }
+}
+
+bool advance_local_row(const r2degree& current_grid_degree, const R2Mat& M, int& local_y) {
+    bool moved = false;
+    while(local_y + 1 < static_cast<int>(M.y_grid.size()) && current_grid_degree.second >= M.y_grid[local_y + 1]){
+        local_y++;
+        moved = true;
+    }
+    return moved;
+}
+
+Dynamic_HNF* Prefetched_rows::find(int k) {
+    auto position = std::lower_bound(summands.begin(), summands.end(), k);
+    if(position == summands.end() || *position != k){
+        return nullptr;
+    }
+    return &rows[position - summands.begin()];
+}
+
+void prefetch_local_rows(const vec<R2Mat*>& summands,
+    const int& grid_length_y,
+    const vec<double>& xs,
+    const r2degree& lower_bound,
+    const r2degree& grid_step,
+    const pair<r2degree>& slope_bounds,
+    aida::AIDA_functor& decomposer,
+    Bounded_queue<Prefetched_rows>& queue) {
+
+    vec<int> local_rows(summands.size(), -1);
+    for(int j = 0; j < grid_length_y; j++){
+        // Same degree as in process_grid_row, so that the rows change at the same points.
+        r2degree row_degree = {lower_bound.first, lower_bound.second + j*grid_step.second};
+        Prefetched_rows prefetched;
+        for(size_t k = 0; k < summands.size(); k++){
+            R2Mat& M = *summands[k];
+            if(M.get_num_rows() == 0 || M.x_grid.empty() || !advance_local_row(row_degree, M, local_rows[k])){
+                continue;
+            }
+            prefetched.summands.push_back(k);
+            prefetched.rows.emplace_back();
+            Dynamic_HNF& row = prefetched.rows.back();
+            row.compute_HNF_row(decomposer, M, local_rows[k], slope_bounds);
+            row.compute_cells_at(decomposer, M, xs);
+        }
+        if(!queue.push(std::move(prefetched))){
+            return;
+        }
+    }
+}
+
+void update_HNF_row_of_summand(
+    const r2degree& current_grid_degree,
+    R2Mat& M,
+    pair<int>& grid_location,
+    Dynamic_HNF& local_row_data,
+    aida::AIDA_functor& decomposer,
+    const pair<r2degree>& slope_bounds) {
+
+    grid_location.first = -1; // Reset x-coordinate
+    int& local_y = grid_location.second;
+    bool recompute = advance_local_row(current_grid_degree, M, local_y);
+
+    if(recompute){
+        local_row_data.compute_HNF_row(decomposer, M, local_y, slope_bounds);
+    }
+    if(local_y != -1){
+        assert(current_grid_degree.second >= M.y_grid[local_y] );
+        if( local_y +1 < static_cast<int>(M.y_grid.size())){
+            assert(current_grid_degree.second < M.y_grid[local_y + 1]);
+        } 
+    }
+}
+
+void update_grid_location_x_of_summand(
+    const r2degree& current_grid_degree,
+    R2Mat& M,
+    int& local_x,
+    const int k) {
+    
+    if(local_x + 1 == static_cast<int>(M.x_grid.size()) ){
+        
+    } else {
+        if(false){
+            std::cout << std::setprecision(12);
+            std::cout << "  Updating x grid locations at grid degree " << current_grid_degree << std::endl;
+            std::cout << "  local_x: " << local_x << std::endl;
+            std::cout << "  M.x_grid for the next value: " << M.x_grid[local_x + 1] << std::endl;
+            std::cout << std::endl;
+            if(local_x + 1 < static_cast<int>(M.x_grid.size()) ){
+                std::cout << " Not at end yet. " << std::endl;
+                auto B_induced = M.submodule_generated_at(current_grid_degree);
+                std::cout << B_induced.get_num_rows() << " rows in the induced submodule at the current grid degree." << std::endl;
+                if(B_induced.get_num_rows() != 0){
+                    std::cout << "  We're not in the local grid yet, but there is already a non-trivial submodule induced at the current grid degree:" << current_grid_degree << std::endl;
+                    std::cout << "  The indecomposable is at position: " << k << " and has presentation " << std::endl;
+                    M.print_graded();
+                    std::cout << "  The induced submodule has presentation " << std::endl;
+                    B_induced.print_graded();
+                    if(current_grid_degree.first >= M.x_grid[local_x + 1]){
+                        std::cout << "moving forward as planned.   " << std::endl;
+                    } else {
+                        std::cout << "M_xgrid[local_x + 1] is " << M.x_grid[local_x + 1] << std::endl;
+                        std::cout << "  But the current grid degree is smaller than the next x grid point, so we should not move forward yet." << std::endl;
+                        std::cout << "  This should not happen, check the grid computation." << std::endl;
+                    }
+
+                }
+                
+            }
+        }
+        while(local_x + 1 < static_cast<int>(M.x_grid.size()) ){
+            if(current_grid_degree.first >= M.x_grid[local_x + 1]){
+                local_x++;
+            } else {
+                break;
+            }
+        }
+    }
+    if(local_x != -1){
+        assert(current_grid_degree.first >= M.x_grid[local_x]);
+        if( local_x + 1 < static_cast<int>(M.x_grid.size()) ){
+            assert(current_grid_degree.first < M.x_grid[local_x + 1]);
+        } 
+    }
+}
+
+void process_summand_at_grid_cell(
+    int i, int j, int k,
+    const r2degree& current_grid_degree,
+    R2Mat& M,
+    const pair<int>& grid_location,
+    Dynamic_HNF& local_row_data,
+    vec<HN_factors>& composition_factors,
+    vec<int>& grid_ind_dimensions,
+    const pair<r2degree>& slope_bounds,
+    aida::AIDA_functor& decomposer) {
+    
+    bool test = false;
+    
+    bool track= false;
+    vec<HN_factors> test_factors = vec<HN_factors>();
+    vec<HN_factors> copy_factors =  vec<HN_factors>();
+    auto& local_grid_index = grid_location;
+    const int& local_x = local_grid_index.first;
+    r2degree local_grid_degree;
+
+
+    if(local_x == -1 || local_grid_index.second == -1){
+        if(track){
+            std::cout << " tracking at grid point " << current_grid_degree << std::endl;
+            auto B_induced = M.submodule_generated_at(current_grid_degree);
+            if(B_induced.get_num_rows() != 0){
+                std::cout << "  We're not in the local grid yet, but there is already a non-trivial submodule induced at the current grid degree:" << current_grid_degree << std::endl;
+                std::cout << "  The indecomposable is at position: " << k << " and has presentation " << std::endl;
+                M.print_graded();
+                std::cout << "  The induced submodule has presentation " << std::endl;
+                B_induced.print_graded();
+            }
+        }
+        // We're not in the local grid yet, so can skip this summand.
+        return;
+    } else {
+        local_grid_degree = std::make_pair(M.x_grid[local_grid_index.first], M.y_grid[local_grid_index.second]);
+    }
+
+    
+    
+    Dynamic_HNF& local_dhnf =  local_row_data;
+    local_dhnf.compute_cell(decomposer, M, local_x);
+    auto& local_summands = local_dhnf.indecomposable_summands[local_x];
+
+    
+    if(test){
+        auto B_induced = M.submodule_generated_at(current_grid_degree);
+        if(B_induced.get_num_rows() != 0){
+            Block_list sub_B_list;
+            B_induced.compute_col_batches();
+            decomposer(B_induced, sub_B_list);
+            assert(local_summands.size() == sub_B_list.size());
+            test_factors = skyscraper_invariant_sum(sub_B_list, slope_bounds);
+        } else {
+            assert(local_summands.size() == 0);
+        }
+    }
+    
+    for(size_t s = 0; s < local_summands.size(); s++){
+        Uni_B1& summand = local_summands[s];
+        double area = static_cast<double>(1)/summand.slope_value;
+        auto shifted_summand = summand;
+        r2degree verschiebung = current_grid_degree - local_grid_degree;
+        if( shifted_summand.d1.get_num_rows() == 0){
+            std::cout << " Empty summands should have been filtered out." << std::endl;
+            assert(false);
+        } else if(shifted_summand.d1.get_num_rows() == 1){
+            double test_slope1 = shifted_summand.slope_value;
+            double slope = shifted_summand.evaluate_slope_polynomial(verschiebung, slope_bounds);
+            if( test_slope1 > slope){
+                std::cout << "  -   Decreasing slope after shifting by Verschiebung: " << test_slope1 << " original vs. now" << slope << std::endl;
+                std::cout << "original area: " << area << " vs current " << shifted_summand.evaluate_area_polynomial(verschiebung, slope_bounds) << std::endl;
+                std::cout << "  area polynomial: " << shifted_summand.area_polynomial[0] << "  " << shifted_summand.area_polynomial[1] << "  " << shifted_summand.area_polynomial[2]  << std::endl;
+                std::cout << "  Current grid degree: " << current_grid_degree << std::endl;
+                std::cout << "  Local grid degree: " << local_grid_degree << std::endl;
+                std::cout << "  i: " << i << ", j: " << j << ", k: " << k << std::endl;
+                std::cout << "  Verschiebung: " << verschiebung << std::endl;
+                std::cout << "  Slope bounds: " << slope_bounds.first << " " << slope_bounds.second << std::endl;
+                std::cout << "  Module: " << std::endl;
+                shifted_summand.d1.print_graded();
+                std::cout << "  range_area " << (slope_bounds.second.first - slope_bounds.first.first) * (slope_bounds.second.second - slope_bounds.first.second) << std::endl;
+                assert(false);
+            }
+            if(test){
+                double area = shifted_summand.evaluate_area_polynomial(verschiebung, slope_bounds);
+                R2Mat test_cutoff = shifted_summand.d1.submodule_generated_at(current_grid_degree);
+                if(test_cutoff.get_num_rows() != 0){
+                    Uni_B1 test_summand(test_cutoff);
+                    // double test_slope = test_summand.slope(slope_bounds);
+                    double test_area = test_summand.area(slope_bounds);
+                    if(essentially_equal(area, test_area, 1e-7, 1e-9) == false){
+                        std::cout << std::fixed << std::setprecision(12);
+                        std::cout << "  Area mismatch at direct cutting off: " << area << " vs. " << test_area << std::endl;
+                        std::cout << "  Difference: " << area - test_area << std::endl;
+                        std::cout << "  Current grid degree: " << current_grid_degree << std::endl;
+                        std::cout << "  Local grid degree: " << local_grid_degree << std::endl;
+                        std::cout << "  i: " << i << ", j: " << j << ", k: " << k << std::endl;
+                        std::cout << "  Summand: " << std::endl;
+                        shifted_summand.d1.print_graded();
+                        std::cout << "  area polynomial: " << 
+                            shifted_summand.area_polynomial[0] << "  " << shifted_summand.area_polynomial[1] << "  " << 
+                            shifted_summand.area_polynomial[2]  << std::endl;
+                        std::cout << "  Verschiebung: " << verschiebung << std::endl;
+                        std::cout << "  Slope bounds: " << slope_bounds.first << " " << slope_bounds.second << std::endl;
+                        auto normalisation = slope_bounds.second - slope_bounds.first;
+                        std::cout << "  Normalisation area: " << normalisation.first * normalisation.second << std::endl;
+                        std::cout << "  Cut off summand: " << std::endl;
+                        test_summand.d1.print_graded();
+                        assert(false);
+                    }
+                }
+            }
+            // TO-DO: summand is the original local summand, we need to cut it off at the current grid degree,
+            // Even if the slope is already correctly computed by the polynomial.
+            shifted_summand.d1.set_all_generator_degrees(current_grid_degree);
+            shifted_summand.d1.column_reduction_graded();
+            shifted_summand.slope_value = slope;
+            HN_factors singleton = HN_factors();
+            singleton.emplace_back(std::move(shifted_summand));
+            composition_factors.emplace_back(singleton);
+            if(test){
+                copy_factors.emplace_back(singleton);
+            }
+            grid_ind_dimensions.push_back(1);
+        } else {
+            grid_ind_dimensions.push_back(shifted_summand.d1.get_num_rows());
+            auto cut_off = shifted_summand.d1;
+            cut_off.set_all_generator_degrees(current_grid_degree);
+            if(test){
+                skyscraper_invariant(cut_off, copy_factors, slope_bounds);
+            }
+            // Inside a local cell only the generator degree moves, so the last filtration usually still holds.
+            Shiftable_filtration& filtration = local_dhnf.filtrations[local_x][s];
+            const auto& subdivision = local_dhnf.subdivisions[local_x][s];
+            HN_factors shifted_factors;
+            if(subdivision && hnf_from_subdivision(*subdivision, current_grid_degree - local_grid_degree, slope_bounds, shifted_factors)){
+                for(Uni_B1& factor : shifted_factors){
+                    factor.d1.set_all_generator_degrees(current_grid_degree);
+                }
+                composition_factors.emplace_back(std::move(shifted_factors));
+            } else if(filtration.valid && filtration.shift(current_grid_degree, slope_bounds, shifted_factors)){
+                composition_factors.emplace_back(std::move(shifted_factors));
+            } else if(filtration.compute(cut_off, slope_bounds)){
+                composition_factors.emplace_back(filtration.factors);
+            } else {
+                skyscraper_invariant(cut_off, composition_factors, slope_bounds);
+            }
+        }
+        
+        
+    }
+    if(test){
+        compare_slopes_test(current_grid_degree, local_grid_degree, 
+                copy_factors, test_factors, i, j, k);
+    }
+}
+
+void sweep_summand_over_rows(int k, R2Mat& M, Summand_sweep& sweep,
+    int j_begin, int j_end,
+    const int& grid_length_x,
+    const r2degree& lower_bound,
+    const r2degree& grid_step,
+    const pair<r2degree>& slope_bounds,
+    aida::AIDA_functor& decomposer,
+    vec<HN_factors>& cell_streams) {
+
+    cell_streams.clear();
+    cell_streams.resize((j_end - j_begin) * grid_length_x);
+    vec<HN_factors> local_factors;
+    for(int j = j_begin; j < j_end; j++){
+        r2degree current_grid_degree;
+        current_grid_degree.first = lower_bound.first - grid_step.first*0.999;
+        current_grid_degree.second = lower_bound.second + j*grid_step.second;
+        update_HNF_row_of_summand(current_grid_degree, M, sweep.grid_location, sweep.local_row_data, decomposer, slope_bounds);
+        for(int i = 0; i < grid_length_x; i++){
+            current_grid_degree.first += grid_step.first;
+            update_grid_location_x_of_summand(current_grid_degree, M, sweep.grid_location.first, k);
+            local_factors.clear();
+            process_summand_at_grid_cell(i, j, k, current_grid_degree, M, sweep.grid_location, sweep.local_row_data,
+                local_factors, sweep.grid_ind_dimensions, slope_bounds, decomposer);
+            // Every local summand already has its factors sorted by decreasing slope.
+            cell_streams[(j - j_begin) * grid_length_x + i] = k_merge(local_factors);
+        }
+    }
+}
+
+double number_of_subspaces(int k) {
+    // Sum of the Gaussian binomials [k choose d]_2, each computed with the recursion in d.
+    double total = 0;
+    double gaussian_binomial = 1;
+    for(int d = 0; d <= k; d++){
+        total += gaussian_binomial;
+        gaussian_binomial *= (std::pow(2.0, k - d) - 1) / (std::pow(2.0, d + 1) - 1);
+    }
+    return total;
+}
+
+double hnf_cost_estimate(const vec<Uni_B1>& local_summands) {
+    double cost = 0;
+    for(const Uni_B1& summand : local_summands){
+        int dim = summand.d1.get_num_rows();
+        double num_relations = std::max(1, summand.d1.get_num_cols());
+        if(dim <= 1){
+            cost += num_relations;
+        } else {
+            // Every subspace costs a submodule computation, roughly linear in the number of relations.
+            cost += number_of_subspaces(dim) * num_relations;
+        }
+    }
+    return cost;
+}
+
+void induced_submodule_factors(R2Mat& B_induced,
+    Induced_decomposition& cache,
+    vec<HN_factors>& composition_factors,
+    vec<int>& grid_ind_dimensions,
+    const pair<r2degree>& slope_bounds,
+    aida::AIDA_functor& decomposer) {
+
+    assert(B_induced.get_num_rows() > 1);
+    const r2degree& generator_degree = B_induced.row_degrees[0];
+    bool uniquely_generated = std::all_of(B_induced.row_degrees.begin(), B_induced.row_degrees.end(), 
+        [&](const r2degree& degree) { return degree == generator_degree; });
+    bool reuse = uniquely_generated && cache.valid
+        && cache.relations.get_num_rows() == B_induced.get_num_rows()
+        && cache.relations.col_degrees == B_induced.col_degrees
+        && cache.relations.data == B_induced.data;
+
+    if(reuse){
+        // AIDA only depends on the relations, so the blocks are the same up to their generator degree.
+        for(Block& block : cache.blocks){
+            block.set_all_generator_degrees(generator_degree);
+        }
+        cache.num_reused++;
+    } else {
+        cache.relations = B_induced;
+        cache.blocks.clear();
+        B_induced.compute_col_batches();
+        decomposer(B_induced, cache.blocks);
+        cache.filtrations.assign(cache.blocks.size(), Shiftable_filtration());
+        cache.valid = uniquely_generated;
+    }
+
+    size_t b = 0;
+    HN_factors shifted_factors;
+    for(Block& block : cache.blocks){
+        grid_ind_dimensions.push_back(block.get_num_rows());
+        // With the same relations only the generators have moved, so the last filtration holds if its margins say so.
+        // Otherwise it is recomputed, warm-started with its scss chain.
+        Shiftable_filtration& filtration = cache.filtrations[b++];
+        if(reuse && filtration.valid && in_same_relation_cell(block, filtration.generator_degree, generator_degree)
+            && filtration.shift(generator_degree, slope_bounds, shifted_factors)){
+            composition_factors.push_back(std::move(shifted_factors));
+        } else if(block.get_num_rows() > 1 && filtration.compute(block, slope_bounds)){
+            composition_factors.push_back(filtration.factors);
+        } else if(block.get_num_rows() > 0){
+            skyscraper_invariant(block, composition_factors, slope_bounds);
+        }
+    }
+}
+
 // Dynamic_HNF
 Dynamic_HNF::Dynamic_HNF() {
     indecomposable_summands = vec<vec<Uni_B1>>();
+    filtrations = vec<vec<Shiftable_filtration>>();
+    subdivisions = vec<vec<std::shared_ptr<const Slope_subdivision>>>();
     grid_ind_dimensions = vec<int>();
 }
 
 void Dynamic_HNF::compute_HNF_row(aida::AIDA_functor& decomposer,
-        R2Mat& M, int& y_index, pair<r2degree> slope_bounds,
-        const vec<vec<vec<SparseMatrix<int>>>>& subspaces) {
+        R2Mat& M, int& y_index, pair<r2degree> slope_bounds) {
     assert(y_index > -1);
-    double y_coordinate = M.y_grid[y_index];
     int x_length = M.x_grid.size();
-    double y_next;
+    row_index = y_index;
+    bounds = slope_bounds;
     if(y_index < M.y_grid.size()-1){
         y_next = M.y_grid[y_index+1];
     } else {
         y_next = slope_bounds.second.second;
     }
     indecomposable_summands = vec<vec<Uni_B1>>(x_length, vec<Uni_B1>());
-    int max_dim = 0;
+    filtrations = vec<vec<Shiftable_filtration>>(x_length);
+    subdivisions = vec<vec<std::shared_ptr<const Slope_subdivision>>>(x_length);
+    computed = vec<bool>(x_length, false);
+    last_computed = -1;
+}
 
-    for(int x_index = 0; x_index < x_length; x_index++){
-        r2degree grid_point = {M.x_grid[x_index], y_coordinate};
-        double next_x;
-        if(x_index < M.x_grid.size()-1){
-            next_x = M.x_grid[x_index+1];
-        } else {
-            next_x = slope_bounds.second.first;
-        }
-        auto M_induced = M.submodule_generated_at(grid_point);
-        if(M_induced.get_num_rows() == 0){
-            // Nothing to do?
-        } else if (M_induced.get_num_rows() == 1){
-            Uni_B1 res(std::move(M_induced));
-            indecomposable_summands[x_index].push_back(res);
-            indecomposable_summands[x_index].back().compute_area_polynomial(slope_bounds);
-            indecomposable_summands[x_index].back().compute_slope(slope_bounds);
-            grid_ind_dimensions.push_back(1);
-        } else {
-            aida::Block_list sub_M_list;
-            M_induced.compute_col_batches();
-            decomposer(M_induced, sub_M_list);
-            for(Block sub_M : sub_M_list){
-                if(sub_M.get_num_rows() > max_dim){
-                    max_dim = sub_M.get_num_rows();
-                }
-                indecomposable_summands[x_index].emplace_back(Uni_B1(std::move(sub_M)));
-                Uni_B1& current_summand =  indecomposable_summands[x_index].back();
-                current_summand.compute_area_polynomial(slope_bounds);
-                current_summand.compute_slope(slope_bounds);
-                grid_ind_dimensions.push_back(sub_M.get_num_rows());
-                int dim = current_summand.d1.get_num_rows();
-                if(false){
-                    if(dim > 2){
-                        current_summand.d1.to_stream_r2(std::cout);
-                    }
+bool Dynamic_HNF::compute_cell(aida::AIDA_functor& decomposer, R2Mat& M, int x_index) {
+    assert(row_index > -1);
+    if(computed[x_index]){
+        return false;
+    }
+    computed[x_index] = true;
+    const pair<r2degree>& slope_bounds = bounds;
+    r2degree grid_point = {M.x_grid[x_index], M.y_grid[row_index]};
+    double next_x;
+    if(x_index < M.x_grid.size()-1){
+        next_x = M.x_grid[x_index+1];
+    } else {
+        next_x = slope_bounds.second.first;
+    }
+    auto M_induced = M.submodule_generated_at(grid_point);
+    if(M_induced.get_num_rows() == 0){
+        // Nothing to do?
+    } else if (M_induced.get_num_rows() == 1){
+        Uni_B1 res(std::move(M_induced));
+        indecomposable_summands[x_index].push_back(res);
+        indecomposable_summands[x_index].back().compute_area_polynomial(slope_bounds);
+        indecomposable_summands[x_index].back().compute_slope(slope_bounds);
+        filtrations[x_index].emplace_back();
+        subdivisions[x_index].emplace_back();
+        grid_ind_dimensions.push_back(1);
+    } else {
+        aida::Block_list sub_M_list;
+        M_induced.compute_col_batches();
+        decomposer(M_induced, sub_M_list);
+        for(Block sub_M : sub_M_list){
+            indecomposable_summands[x_index].emplace_back(Uni_B1(std::move(sub_M)));
+            Uni_B1& current_summand =  indecomposable_summands[x_index].back();
+            current_summand.compute_area_polynomial(slope_bounds);
+            current_summand.compute_slope(slope_bounds);
+            grid_ind_dimensions.push_back(sub_M.get_num_rows());
+            filtrations[x_index].emplace_back();
+            int dim = current_summand.d1.get_num_rows();
+            // The neighbouring summands usually split the same way, so the chain of the summand at the same position 
+            // in the last decomposed cell of the row seeds the first computation here. A seed that does not fit is ignored.
+            size_t s = filtrations[x_index].size() - 1;
+            if(last_computed != -1 && s < filtrations[last_computed].size() 
+                && indecomposable_summands[last_computed][s].d1.get_num_rows() == dim){
+                filtrations[x_index].back().chain = filtrations[last_computed][s].chain;
+            }
+            if(false){
+                if(dim > 2){
+                    current_summand.d1.to_stream_r2(std::cout);
                 }
+            }
 
-                if(false){
-                    r2degree upper_grid_corner = {next_x, y_next};
-                    // current_summand.compute_slope_subdivision(slope_bounds, subspaces, grid_point, upper_grid_corner);
-                }
+            if(dim > 1 && hnf_search_config().slope_subdivision){
+                r2degree upper_grid_corner = {next_x, y_next};
+                subdivisions[x_index].push_back(
+                    compute_cell_subdivision(current_summand, slope_bounds, grid_point, upper_grid_corner));
+            } else {
+                subdivisions[x_index].emplace_back();
             }
         }
     }
-    if (max_dim >= 7){
-        // std::cout << " Careful, there are high-dimensional summands which might slow down HNF computation excessively." << std::endl;
-    }  
+    last_computed = x_index;
+    return true;
+}
+
+void Dynamic_HNF::compute_cells_at(aida::AIDA_functor& decomposer, R2Mat& M, const vec<double>& xs) {
+    assert(std::is_sorted(xs.begin(), xs.end()));
+    int x_length = M.x_grid.size();
+    int local_x = -1;
+    for(double x : xs){
+        while(local_x + 1 < x_length && x >= M.x_grid[local_x + 1]){
+            local_x++;
+        }
+        if(local_x != -1){
+            compute_cell(decomposer, M, local_x);
+        }
+    }
 }
 
 
@@ -243,13 +857,26 @@ void display_help() {
         << "  -r, --resolution <x,y>      Set grid resolution (default: 200,200)\n"
         << "  -y, --dynamic_grid          Disable dynamic grid (use fixed resolution)\n"
         << "  -k, --grassmann <n>         Set Grassmann value for the computation\n"
-        << "  -u, --subdivision           Enable subdivision mode\n"
+        << "  -u, --subdivision           Precompute the HN types of every local cell and look them up\n"
+        << "  -n, --threads <n>           Compute rows of the grid on n threads (default: 1, 0: all cores)\n"
+        << "  -m, --summand_tasks         Sweep every indecomposable as its own task (use with -n)\n"
+        << "  -w, --work_stealing         Schedule (indecomposable, local cell) tasks by cost (use with -n)\n"
+        << "  -q, --pipeline              Decompose local rows on a second thread ahead of the sweep (without -n)\n"
+        << "  -a, --grassmann_cache <f>   Read the subspace tables from f, extend f if more are needed\n"
+        << "  -i, --exhaustive_hnf        Search all subspaces for the HNF instead of branch and bound\n"
+        << "  -z, --no_hnf_cache          Do not reuse HN filtrations of translated presentations\n"
         << "  -f, --alpha                 Enable computation of alpha-homs\n"
         << "  -j, --no_hom_opt            Disable optimised hom-space calculation\n\n"
         << "Output:\n"
         << "  -o, --output [file]         Write output to file\n"
         << "                              Defaults to <input_file>.sky if no path is given\n"
         << "  -g, --diagonal              Also save a diagonal-restricted copy (for landscapes)\n"
+        << "  -B, --binary                Write the binary, memory-mappable format to <input_file>.skb\n"
+        << "  -H, --hdf5                  Write chunked, compressed HDF5 datasets to <input_file>.h5\n"
+        << "                              (needs a build with -DWITH_HDF5=ON)\n"
+        << "  -D, --dictionary            Write every distinct staircase once, run-length encoded, to <input_file>.skd\n"
+        << "  -R, --regions               Write the exact regions of constant HN type to <input_file>.skr\n"
+        << "                              instead of sampling the grid, see sky_from_regions\n"
         << "  -c, --basechange            Save the base change alongside the decomposition\n\n"
         << "Diagnostics:\n"
         << "  -s, --statistics            Show statistics about indecomposable summands\n"
@@ -268,13 +895,12 @@ void display_version() {
 
 
 
-void write_to_file(const std::ostringstream& ostream, 
-    std::string output_file_path, 
-    const std::string& input_directory, 
+std::string resolve_output_path(const std::string& input_directory, 
     const std::string& file_without_extension, 
     const std::string& extension, 
     const std::string& output_string){
 
+    std::string output_file_path;
     if(output_string.empty()){
         output_file_path = input_directory + "/" + file_without_extension + extension;
     } else {
@@ -293,7 +919,17 @@ void write_to_file(const std::ostringstream& ostream,
     }
 
     std::filesystem::create_directories(std::filesystem::path(output_file_path).parent_path());
+    return output_file_path;
+}
+
+void write_to_file(const std::ostringstream& ostream, 
+    std::string output_file_path, 
+    const std::string& input_directory, 
+    const std::string& file_without_extension, 
+    const std::string& extension, 
+    const std::string& output_string){
 
+    output_file_path = resolve_output_path(input_directory, file_without_extension, extension, output_string);
     std::ofstream file_out(output_file_path);
     if(file_out.is_open()){
         file_out << ostream.str();
@@ -1,7 +1,93 @@
 #include "hnf_at.hpp"
+#include "grassmannian_table.hpp"
+#include "relation_staircase.hpp"
+#include "f2_matrix.hpp"
+#include "hnf_cache.hpp"
+#include <cstdint>
+#include <optional>
 
 namespace hnf {
 
+namespace {
+
+/**
+ * @brief Minimal presentation of the submodule of X generated by subspace, with the bit-packed kernel if X is small enough.
+ */
+R2Mat minimal_submodule(const R2Mat& X, const R2Mat& subspace) {
+    if(f2_kernel_applies(X)){
+        return f2_submodule_generated_by(X, subspace);
+    }
+    R2Mat submodule_pres = X.submodule_generated_by(subspace);
+    submodule_pres.minimize();
+    return submodule_pres;
+}
+
+void quotient(R2Mat& X, const R2Mat& subspace) {
+    if(f2_kernel_applies(X)){
+        f2_quotient_by(X, subspace);
+    } else {
+        X.quotient_by(subspace);
+    }
+}
+
+vec<uint64_t> reduced_echelon_form(const uint64_t* rows, size_t dim) {
+    F2_echelon_basis basis;
+    for(size_t r = 0; r < dim; r++){
+        basis.add(rows[r]);
+    }
+    return basis.vectors;
+}
+
+/**
+ * @brief Order of tied subspaces, given by their reduced row echelon forms: smaller dimension first, then lexicographic.
+ */
+bool precedes_in_tie(const vec<uint64_t>& a, const vec<uint64_t>& b) {
+    return a.size() < b.size() || (a.size() == b.size() && a < b);
+}
+
+/**
+ * @brief The columns of subspace as bitmasks over the generators.
+ */
+vec<uint64_t> rows_from_subspace(const SparseMatrix<int>& subspace) {
+    vec<uint64_t> rows(subspace.get_num_cols(), 0);
+    for(size_t c = 0; c < rows.size(); c++){
+        for(int row : subspace.data[c]){
+            rows[c] |= uint64_t(1) << row;
+        }
+    }
+    return rows;
+}
+
+} // namespace
+
+void Scss_candidates::offer(double slope, const uint64_t* rows, size_t dim) {
+    if(slope < threshold()){
+        return;
+    }
+    if(slope > maximum){
+        maximum = slope;
+        // The window moves up, candidates below it can not come back.
+        tied.erase(std::remove_if(tied.begin(), tied.end(), [&](const Candidate& candidate) {
+            return candidate.slope < threshold();
+        }), tied.end());
+        best = 0;
+        for(size_t i = 1; i < tied.size(); i++){
+            if(precedes_in_tie(tied[i].echelon_form, tied[best].echelon_form)){
+                best = i;
+            }
+        }
+    }
+    tied.push_back({slope, vec<uint64_t>(rows, rows + dim), reduced_echelon_form(rows, dim)});
+    if(tied.size() == 1 || precedes_in_tie(tied.back().echelon_form, tied[best].echelon_form)){
+        best = tied.size() - 1;
+    }
+}
+
+const vec<uint64_t>& Scss_candidates::winner() const {
+    static const vec<uint64_t> none;
+    return tied.empty() ? none : tied[best].rows;
+}
+
 HN_factors split_into_intervals(Uni_B1& stable_module){
     R2Mat pres = stable_module.d1;
     HN_factors intervals;
@@ -12,11 +98,9 @@ HN_factors split_into_intervals(Uni_B1& stable_module){
         subspace.data = {{0}};
         subspace.row_degrees = pres.row_degrees;
         subspace.col_degrees = vec<r2degree>(1, pres.row_degrees[0]);
-        R2Mat submodule_pres = pres.submodule_generated_by(subspace);
-        submodule_pres.minimize();
-        intervals.emplace_back(Uni_B1(submodule_pres));
+        intervals.emplace_back(Uni_B1(minimal_submodule(pres, subspace)));
         intervals.back().slope_value = slope;
-        pres.quotient_by(subspace);
+        quotient(pres, subspace);
     }
     
     return intervals;
@@ -98,84 +182,173 @@ void recalculate_slopes(HN_factors& composition_factors) {
 bool slope_comparator::operator()(const Uni_B1& X, const Uni_B1& Y) const noexcept {
     return X.slope_value > Y.slope_value;
 }
-vec<Uni_B1> get_slopes_at_dim(const R2Mat& X,
-    vec<SparseMatrix<int>>& grassmanian,
-    Uni_B1& scss,
-    R2Mat& max_subspace,
+namespace {
+
+template<typename F>
+void for_each_subspace(const vec<SparseMatrix<int>>& grassmanian, F&& f) {
+    for(const auto& ungraded_subspace : grassmanian){
+        f(ungraded_subspace);
+    }
+}
+
+template<typename F>
+void for_each_subspace(Grassmannian_enumerator&& grassmanian, F&& f) {
+    grassmanian.for_each(f);
+}
+
+/**
+ * @brief The submodule of X generated by ungraded_subspace, with its slope. 
+ * subspace is set to ungraded_subspace, graded like the generators of X.
+ */
+Uni_B1 generated_submodule(const R2Mat& X,
+    const SparseMatrix<int>& ungraded_subspace,
+    R2Mat& subspace,
     const pair<r2degree>& bounds) {
-    vec<Uni_B1> submodules;
-    for(auto ungraded_subspace : grassmanian){
-        int num_gens = ungraded_subspace.get_num_cols();
-        if(num_gens == 0){
-            continue;
-        }
-        R2Mat subspace = R2Mat(ungraded_subspace);
-        subspace.row_degrees = X.row_degrees;
-        subspace.col_degrees = vec<r2degree>(num_gens, X.row_degrees[0]);
-        assert(subspace.get_num_rows() == X.get_num_rows());
-        assert(subspace.get_num_cols() == num_gens);
-        R2Mat submodule_pres = X.submodule_generated_by(subspace);
-        submodule_pres.minimize();
-        submodules.emplace_back(Uni_B1(submodule_pres));
-        submodules.back().slope_value = submodules.back().slope(bounds);
-        if(submodules.back().slope_value > scss.slope_value){
-            scss = submodules.back();
-            max_subspace = subspace;
+    int num_gens = ungraded_subspace.get_num_cols();
+    subspace = R2Mat(ungraded_subspace);
+    subspace.row_degrees = X.row_degrees;
+    subspace.col_degrees = vec<r2degree>(num_gens, X.row_degrees[0]);
+    assert(subspace.get_num_rows() == X.get_num_rows());
+    assert(subspace.get_num_cols() == num_gens);
+    Uni_B1 res(minimal_submodule(X, subspace));
+    res.slope_value = res.slope(bounds);
+    return res;
+}
+
+/**
+ * @brief Computes the slope of the submodule of X generated by ungraded_subspace and offers the subspace to candidates.
+ * Returns the slope, or -1 for the zero subspace.
+ */
+double update_scss(const R2Mat& X,
+    const SparseMatrix<int>& ungraded_subspace,
+    Scss_candidates& candidates,
+    const pair<r2degree>& bounds) {
+    if(ungraded_subspace.get_num_cols() == 0){
+        return -1;
+    }
+    R2Mat subspace;
+    double slope = generated_submodule(X, ungraded_subspace, subspace, bounds).slope_value;
+    candidates.offer(slope, rows_from_subspace(ungraded_subspace));
+    return slope;
+}
+
+SparseMatrix<int> subspace_from_rows(const vec<uint64_t>& rows, int k) {
+    SparseMatrix<int> subspace(rows.size(), k);
+    for(size_t c = 0; c < rows.size(); c++){
+        for(int row = 0; row < k; row++){
+            if(rows[c] & (uint64_t(1) << row)){
+                subspace.data[c].push_back(row);
+            }
         }
     }
-    return submodules;
+    return subspace;
 }
 
-void find_scss_of_dim(const R2Mat& X,
-    vec<SparseMatrix<int>>& grassmanian,
-    Uni_B1& scss,
-    R2Mat& max_subspace,
-    const pair<r2degree>& bounds) {
-    for(auto ungraded_subspace : grassmanian){
-        int num_gens = ungraded_subspace.get_num_cols();
-        if(num_gens == 0){
+/**
+ * @brief The subspaces of one dimension in Gray code order, together with the staircase of X
+ * from which their areas are updated incrementally.
+ */
+struct Incremental_grassmannian {
+    const Relation_staircase& staircase;
+    Grassmannian_enumerator subspaces;
+    Scss_candidates& candidates;
+};
+
+/**
+ * @brief Calls f(rows, slope) for every subspace, the slope is computed without a resolution.
+ */
+template<typename F>
+void for_each_subspace_slope(Incremental_grassmannian& grassmanian, F&& f) {
+    Grassmannian_enumerator& subspaces = grassmanian.subspaces;
+    std::optional<Subspace_area> area;
+    while(subspaces.advance()){
+        const vec<uint64_t>& rows = subspaces.basis_rows();
+        if(rows.empty()){
             continue;
         }
-        R2Mat subspace = R2Mat(ungraded_subspace);
-        subspace.row_degrees = X.row_degrees;
-        subspace.col_degrees = vec<r2degree>(num_gens, X.row_degrees[0]);
-        assert(subspace.get_num_rows() == X.get_num_rows());
-        assert(subspace.get_num_cols() == num_gens);
-        R2Mat submodule_pres = X.submodule_generated_by(subspace);
-        submodule_pres.minimize();
-        Uni_B1 res(submodule_pres);
-        res.slope_value = res.slope(bounds);
-        if(res.slope_value > scss.slope_value){
-            scss = res;
-            max_subspace = subspace;
+        auto [row, column] = subspaces.last_change();
+        if(row == -1){
+            area.emplace(grassmanian.staircase, rows);
+        } else {
+            area->flip(row, column);
         }
+        f(rows, rows.size() / area->area());
     }
 }
 
-Uni_B1 find_scss_bruteforce(const R2Mat& X,
-        vec<vec<vec<SparseMatrix<int>>>>& subspaces,
-        R2Mat& max_subspace,
+/**
+ * @brief Like find_scss_of_dim, but also returns the slopes of all submodules it has looked at.
+ */
+template<typename Grassmannian>
+vec<double> get_slopes_at_dim(const R2Mat& X,
+    Grassmannian&& grassmanian,
+    Scss_candidates& candidates,
+    const pair<r2degree>& bounds) {
+    vec<double> slopes;
+    for_each_subspace(std::forward<Grassmannian>(grassmanian), [&](const SparseMatrix<int>& ungraded_subspace) {
+        double slope = update_scss(X, ungraded_subspace, candidates, bounds);
+        if(slope >= 0){
+            slopes.push_back(slope);
+        }
+    });
+    return slopes;
+}
+
+vec<double> get_slopes_at_dim(const R2Mat& X,
+    Incremental_grassmannian&& grassmanian,
+    Scss_candidates& candidates,
+    const pair<r2degree>& bounds) {
+    vec<double> slopes;
+    for_each_subspace_slope(grassmanian, [&](const vec<uint64_t>& rows, double slope) {
+        candidates.offer(slope, rows);
+        slopes.push_back(slope);
+    });
+    return slopes;
+}
+
+template<typename Grassmannian>
+void find_scss_of_dim(const R2Mat& X,
+    Grassmannian&& grassmanian,
+    Scss_candidates& candidates,
+    const pair<r2degree>& bounds) {
+    for_each_subspace(std::forward<Grassmannian>(grassmanian), [&](const SparseMatrix<int>& ungraded_subspace) {
+        update_scss(X, ungraded_subspace, candidates, bounds);
+    });
+}
+
+/**
+ * @brief Computes the slopes from the staircase, without resolutions.
+ */
+void find_scss_of_dim(const R2Mat& X,
+    Incremental_grassmannian&& grassmanian,
+    Scss_candidates& candidates,
+    const pair<r2degree>& bounds) {
+    for_each_subspace_slope(grassmanian, [&](const vec<uint64_t>& rows, double slope) {
+        candidates.offer(slope, rows);
+    });
+}
+
+/**
+ * @brief Searches the subspaces of every dimension, subspaces_of_dim(d) provides those of dimension d.
+ */
+template<typename Subspaces_of_dim>
+void find_scss_by_dimension(const R2Mat& X,
+        Subspaces_of_dim subspaces_of_dim,
+        Scss_candidates& candidates,
         const pair<r2degree>& bounds,
         const bool filter) {
     int k = X.get_num_rows();
-    Uni_B1 scss = Uni_B1(X);
-    scss.slope_value = 0.0;
     if(k == 1){
         // Nothing to do?
     } else {
-        assert(k < 8);
-        if(subspaces.size() < k){
-            std::cerr << "Have not loaded enough subspaces" << std::endl;
-            std::exit(1);
-        }
         vec<bool> filtered_out(k+1, false);
         if(filter){
-            vec<Uni_B1> dim_1_submodules = get_slopes_at_dim(X, subspaces[k-1][1], scss, max_subspace, bounds);
+            vec<double> dim_1_slopes = get_slopes_at_dim(X, subspaces_of_dim(1), candidates, bounds);
             filtered_out[1] = true;
             for(size_t j = 2; j < k+1; j++){
                 size_t high_slope_count = 0;
-                for(const Uni_B1& submodule : dim_1_submodules){
-                    if(submodule.slope_value > scss.slope_value / static_cast<double>(j)){
+                for(double slope : dim_1_slopes){
+                    if(slope > candidates.max_slope() / static_cast<double>(j)){
                         high_slope_count++;
                     } 
                 }
@@ -184,14 +357,13 @@ Uni_B1 find_scss_bruteforce(const R2Mat& X,
                 }
             }
         }
-        for(size_t i = 1; i < subspaces[k-1].size(); i++){
+        for(int i = 1; i <= k; i++){
             if(filter){
                 if(filtered_out[i]){
                     continue;
                 }
             }
-            auto& grassmanian = subspaces[k-1][i];
-            find_scss_of_dim(X, grassmanian, scss, max_subspace, bounds);
+            find_scss_of_dim(X, subspaces_of_dim(i), candidates, bounds);
         }
         if (filter){
             std::cout << " Filtered out all subspaces of dimensions: ";
@@ -203,15 +375,403 @@ Uni_B1 find_scss_bruteforce(const R2Mat& X,
             std::cout << std::endl;
         }
     }
+}
+
+/**
+ * @brief Builds the submodule generated by the rows of the winning subspace. 
+ * If there is none, scss becomes X itself with slope 0, like in the exhaustive search.
+ */
+void build_scss(const R2Mat& X,
+        const vec<uint64_t>& best_rows,
+        Uni_B1& scss,
+        R2Mat& max_subspace,
+        const pair<r2degree>& bounds) {
+    if(best_rows.empty()){
+        scss = Uni_B1(X);
+        scss.slope_value = 0.0;
+    } else {
+        scss = generated_submodule(X, subspace_from_rows(best_rows, X.get_num_rows()), max_subspace, bounds);
+    }
+}
+
+} // namespace
+
+Uni_B1 find_scss_bruteforce(const R2Mat& X,
+        const vec<vec<SparseMatrix<int>>>& grassmannians,
+        R2Mat& max_subspace,
+        const pair<r2degree>& bounds,
+        const bool filter) {
+    assert(X.get_num_rows() == 1 || X.get_num_rows() < static_cast<int>(grassmannians.size()));
+    Scss_candidates candidates;
+    find_scss_by_dimension(X, [&](int d) -> const vec<SparseMatrix<int>>& { return grassmannians[d]; },
+        candidates, bounds, filter);
+    Uni_B1 scss;
+    build_scss(X, candidates.winner(), scss, max_subspace, bounds);
     return scss;
 }
 
-void skyscraper_invariant(const R2Mat& input,
+Uni_B1 find_scss_bruteforce(const R2Mat& X,
+        vec<vec<vec<SparseMatrix<int>>>>& subspaces,
+        R2Mat& max_subspace,
+        const pair<r2degree>& bounds,
+        const bool filter) {
+    int k = X.get_num_rows();
+    if(k > 1 && subspaces.size() < k){
+        std::cerr << "Have not loaded enough subspaces" << std::endl;
+        std::exit(1);
+    }
+    static const vec<vec<SparseMatrix<int>>> no_subspaces;
+    return find_scss_bruteforce(X, k > 1 ? subspaces[k-1] : no_subspaces, max_subspace, bounds, filter);
+}
+
+Uni_B1 find_scss_streaming(const R2Mat& X,
+        R2Mat& max_subspace,
+        const pair<r2degree>& bounds,
+        const bool filter) {
+    int k = X.get_num_rows();
+    Scss_candidates candidates;
+    find_scss_by_dimension(X, [k](int d) { return Grassmannian_enumerator(k, d); },
+        candidates, bounds, filter);
+    Uni_B1 scss;
+    build_scss(X, candidates.winner(), scss, max_subspace, bounds);
+    return scss;
+}
+
+Uni_B1 find_scss_incremental(const R2Mat& X,
+        const Relation_staircase& staircase,
+        R2Mat& max_subspace,
+        const pair<r2degree>& bounds,
+        const bool filter) {
+    int k = X.get_num_rows();
+    assert(staircase.bounded());
+    // No resolution is computed until the winner is known.
+    Scss_candidates candidates;
+    find_scss_by_dimension(X, [&](int d) { return Incremental_grassmannian{staircase, Grassmannian_enumerator(k, d), candidates}; },
+        candidates, bounds, filter);
+    Uni_B1 scss;
+    build_scss(X, candidates.winner(), scss, max_subspace, bounds);
+    return scss;
+}
+
+namespace {
+
+/**
+ * @brief True if rows are linearly independent, nonzero vectors over the first k generators, so that they span a subspace to seed a search with.
+ */
+bool valid_seed(const vec<uint64_t>& rows, int k) {
+    if(rows.empty() || static_cast<int>(rows.size()) > k){
+        return false;
+    }
+    for(uint64_t row : rows){
+        if(row == 0 || (k < 64 && row >> k != 0)){
+            return false;
+        }
+    }
+    return rank_of(rows.data(), rows.size()) == static_cast<int>(rows.size());
+}
+
+/**
+ * @brief Exhaustive search over fixed_grassmannian<K>. Vectors have at most K bits,
+ * so their normal forms modulo the relations of every group are looked up instead of reduced.
+ */
+template<int K>
+Uni_B1 find_scss_fixed_dim(const R2Mat& X,
+        const Relation_staircase& staircase,
+        R2Mat& max_subspace,
+        const pair<r2degree>& bounds,
+        const vec<uint64_t>& seed_rows) {
+    assert(X.get_num_rows() == K && staircase.bounded());
+    constexpr int num_vectors = 1 << K;
+    int num_groups = staircase.num_groups();
+    // normal_forms[g][v] is the normal form of v modulo the relations of group g.
+    vec<std::array<uint8_t, num_vectors>> normal_forms(num_groups);
+    for(int g = 0; g < num_groups; g++){
+        normal_forms[g][0] = 0;
+        for(int v = 1; v < num_vectors; v++){
+            normal_forms[g][v] = normal_forms[g][v & (v - 1)] ^ staircase.reduced_generator(g, __builtin_ctz(v));
+        }
+    }
+
+    // The seed is the best subspace until another one beats it, its slope lets the sums of areas stop early.
+    Scss_candidates candidates;
+    if(valid_seed(seed_rows, K)){
+        candidates.offer(seed_rows.size() / staircase.area(seed_rows), seed_rows);
+    }
+    for(const Fixed_subspace<K>& subspace : fixed_grassmannian<K>){
+        double area = 0;
+        std::array<uint64_t, K> reduced;
+        bool pruned = false;
+        for(int g = 0; g < num_groups && !pruned; g++){
+            for(int r = 0; r < subspace.dim; r++){
+                reduced[r] = normal_forms[g][subspace.rows[r]];
+            }
+            area += staircase.group_area(g) * rank_of(reduced.data(), subspace.dim);
+            // The area only grows, so the slope stays below the threshold.
+            pruned = subspace.dim / area < candidates.threshold();
+        }
+        if(pruned){
+            continue;
+        }
+        double slope = subspace.dim / area;
+        std::array<uint64_t, K> rows;
+        std::copy(subspace.rows.begin(), subspace.rows.end(), rows.begin());
+        candidates.offer(slope, rows.data(), subspace.dim);
+    }
+
+    Uni_B1 scss;
+    build_scss(X, candidates.winner(), scss, max_subspace, bounds);
+    return scss;
+}
+
+} // namespace
+
+Uni_B1 find_scss_fixed(const R2Mat& X,
+        const Relation_staircase& staircase,
+        R2Mat& max_subspace,
+        const pair<r2degree>& bounds,
+        const vec<uint64_t>& seed_rows) {
+    switch(X.get_num_rows()){
+        case 2: return find_scss_fixed_dim<2>(X, staircase, max_subspace, bounds, seed_rows);
+        case 3: return find_scss_fixed_dim<3>(X, staircase, max_subspace, bounds, seed_rows);
+        case 4: return find_scss_fixed_dim<4>(X, staircase, max_subspace, bounds, seed_rows);
+        case 5: return find_scss_fixed_dim<5>(X, staircase, max_subspace, bounds, seed_rows);
+        case 6: return find_scss_fixed_dim<6>(X, staircase, max_subspace, bounds, seed_rows);
+        default:
+            static_assert(max_fixed_dim == 6, "find_scss_fixed has to dispatch to every fixed dimension");
+            return find_scss_incremental(X, staircase, max_subspace, bounds);
+    }
+}
+
+HNF_search_config& hnf_search_config() {
+    static HNF_search_config config;
+    return config;
+}
+
+namespace {
+
+/**
+ * @brief State of the branch and bound search for the scss of X.
+ * Subspaces are stored as the rows of their reduced row echelon form, as bitmasks over the generators of X.
+ * The pivot of a row is its lowest bit. The children of a subspace U append one row whose pivot lies 
+ * beyond the pivots of U and in a column where U vanishes, so every subspace is visited exactly once 
+ * and every subspace below U contains U.
+ */
+struct Scss_search {
+    const R2Mat& X;
+    const pair<r2degree>& bounds;
+    // Computes areas without resolutions, nullptr if X is not bounded.
+    const Relation_staircase* staircase;
+    int k;
+    // The subspaces found so far, the submodule of the winner is only built at the end.
+    Scss_candidates candidates;
+    // Area of the region above the generators where X has no relations, every subspace of dimension e has area e there.
+    double free_area = 0;
+    // line_areas[v] is the area of the submodule generated by the vector v.
+    vec<double> line_areas;
+
+    Scss_search(const R2Mat& X, const pair<r2degree>& bounds, const Relation_staircase* staircase)
+        : X(X), bounds(bounds), staircase(staircase), k(X.get_num_rows()) {}
+
+    void compute_free_area() {
+        if(staircase != nullptr){
+            free_area = staircase->free_area();
+            return;
+        }
+        const r2degree& generator_degree = X.row_degrees[0];
+        for(const r2degree& degree : X.col_degrees){
+            if(Degree_traits<r2degree>::smaller_equal(degree, generator_degree)){
+                return;
+            }
+        }
+        R2Mat free_module(X.get_num_cols(), 1);
+        free_module.data = vec<vec<int>>(X.get_num_cols(), vec<int>{0});
+        free_module.row_degrees = vec<r2degree>(1, generator_degree);
+        free_module.col_degrees = X.col_degrees;
+        f2_minimize(free_module);
+        free_area = Uni_B1(free_module).area(bounds);
+    }
+
+    /**
+     * @brief Area of the submodule generated by rows, which are offered to candidates.
+     */
+    double evaluate(const vec<uint64_t>& rows) {
+        int num_gens = rows.size();
+        double area;
+        if(staircase != nullptr){
+            area = staircase->area(rows);
+        } else {
+            R2Mat subspace;
+            area = generated_submodule(X, subspace_from_rows(rows, k), subspace, bounds).area(bounds);
+        }
+        double slope = num_gens / area;
+        candidates.offer(slope, rows);
+        return area;
+    }
+
+    /**
+     * @brief Upper bound for the slope of a subspace W of dimension e in [e_min, e_max] which contains 
+     * a subspace of dimension m and area area_m, and a vector generating a submodule of area line_area.
+     */
+    double slope_bound(int m, double area_m, double line_area, int e_min, int e_max) const {
+        double bound = 0;
+        for(int e = e_min; e <= e_max; e++){
+            double area_lower = std::max(area_m + (e - m) * free_area, line_area + (e - 1) * free_area);
+            if(area_lower <= 0){
+                return INFINITY;
+            }
+            bound = std::max(bound, e / area_lower);
+        }
+        return bound;
+    }
+
+    /**
+     * @brief Starts the search with the slope of a known subspace, e.g. the scss at a neighbouring degree, 
+     * as lower bound. Rows which do not span a subspace of the generators of X are ignored.
+     */
+    void seed(const vec<uint64_t>& rows) {
+        if(valid_seed(rows, k)){
+            evaluate(rows);
+        }
+    }
+
+    bool can_prune(double bound) const {
+        return bound < candidates.threshold();
+    }
+
+    /**
+     * @brief Visits all subspaces below the subspace spanned by rows, which has area area and consists of the vectors span.
+     */
+    void branch(vec<uint64_t>& rows, const vec<uint64_t>& span, double area, double max_line_area) {
+        int m = rows.size();
+        uint64_t used_columns = 0;
+        for(uint64_t row : rows){
+            used_columns |= row;
+        }
+        int last_pivot = __builtin_ctzll(rows.back());
+        vec<uint64_t> child_span(2 * span.size());
+        for(int q = last_pivot + 1; q < k; q++){
+            if(used_columns & (uint64_t(1) << q)){
+                continue;
+            }
+            int num_free = k - 1 - q;
+            for(uint64_t pattern = 0; pattern < (uint64_t(1) << num_free); pattern++){
+                uint64_t row = (uint64_t(1) << q) | (pattern << (q + 1));
+                double child_line_area = max_line_area;
+                for(size_t s = 0; s < span.size(); s++){
+                    child_span[s] = span[s];
+                    child_span[span.size() + s] = span[s] ^ row;
+                    child_line_area = std::max(child_line_area, line_areas[span[s] ^ row]);
+                }
+                uint64_t child_columns = used_columns | row;
+                int e_max = m + 1;
+                for(int free_q = q + 1; free_q < k; free_q++){
+                    if(!(child_columns & (uint64_t(1) << free_q))){
+                        e_max++;
+                    }
+                }
+                if(can_prune(slope_bound(m, area, child_line_area, m + 1, e_max))){
+                    continue;
+                }
+                rows.push_back(row);
+                double child_area = evaluate(rows);
+                if(e_max > m + 1 && !can_prune(slope_bound(m + 1, child_area, child_line_area, m + 2, e_max))){
+                    branch(rows, child_span, child_area, child_line_area);
+                }
+                rows.pop_back();
+            }
+        }
+    }
+
+    void run() {
+        compute_free_area();
+        line_areas = vec<double>(uint64_t(1) << k, 0);
+        vec<uint64_t> rows(1);
+        for(uint64_t v = 1; v < line_areas.size(); v++){
+            rows[0] = v;
+            line_areas[v] = evaluate(rows);
+        }
+        for(uint64_t v = 1; v < line_areas.size(); v++){
+            rows[0] = v;
+            int e_max = k - __builtin_ctzll(v);
+            for(int q = __builtin_ctzll(v) + 1; q < k; q++){
+                if(v & (uint64_t(1) << q)){
+                    e_max--;
+                }
+            }
+            if(e_max > 1 && !can_prune(slope_bound(1, line_areas[v], line_areas[v], 2, e_max))){
+                branch(rows, vec<uint64_t>{0, v}, line_areas[v], line_areas[v]);
+            }
+        }
+    }
+};
+
+} // namespace
+
+namespace {
+
+Uni_B1 branch_and_bound(const R2Mat& X,
+        const Relation_staircase& staircase,
+        R2Mat& max_subspace,
+        const pair<r2degree>& bounds,
+        const vec<uint64_t>& seed_rows) {
+    if(X.get_num_rows() > max_branch_and_bound_dim){
+        return find_scss_streaming(X, max_subspace, bounds);
+    }
+    Scss_search search(X, bounds, staircase.bounded() ? &staircase : nullptr);
+    search.seed(seed_rows);
+    search.run();
+    Uni_B1 scss;
+    build_scss(X, search.candidates.winner(), scss, max_subspace, bounds);
+    return scss;
+}
+
+} // namespace
+
+Uni_B1 find_scss_branch_and_bound(const R2Mat& X,
+        R2Mat& max_subspace,
+        const pair<r2degree>& bounds,
+        const vec<uint64_t>& seed_rows) {
+    if(X.get_num_rows() == 1){
+        Uni_B1 scss = Uni_B1(X);
+        scss.slope_value = 0.0;
+        return scss;
+    }
+    return branch_and_bound(X, Relation_staircase(X, bounds), max_subspace, bounds, seed_rows);
+}
+
+Uni_B1 find_scss(const R2Mat& X,
+        R2Mat& max_subspace,
+        const pair<r2degree>& bounds,
+        const bool filter,
+        const vec<uint64_t>& seed_rows) {
+    int k = X.get_num_rows();
+    if(k == 1){
+        return find_scss_bruteforce(X, vec<vec<SparseMatrix<int>>>(), max_subspace, bounds, filter);
+    }
+    Relation_staircase staircase(X, bounds);
+    if(!filter && staircase.bounded() && k <= max_fixed_dim){
+        return find_scss_fixed(X, staircase, max_subspace, bounds, seed_rows);
+    } else if(hnf_search_config().branch_and_bound && !filter && k <= max_branch_and_bound_dim){
+        return branch_and_bound(X, staircase, max_subspace, bounds, seed_rows);
+    } else if(staircase.bounded()){
+        return find_scss_incremental(X, staircase, max_subspace, bounds, filter);
+    } else if(k <= Grassmannian_table::max_dim){
+        return find_scss_bruteforce(X, Grassmannian_table::get(k), max_subspace, bounds, filter);
+    } else {
+        return find_scss_streaming(X, max_subspace, bounds, filter);
+    }
+}
+
+namespace {
+
+/**
+ * @brief Peels off the scss with find until the quotient is semistable.
+ */
+template<typename Find_scss>
+void skyscraper_invariant_with(const R2Mat& input,
     vec<HN_factors>& result,
-    vec<vec<vec<SparseMatrix<int>>>>& subspaces,
     const pair<r2degree>& bounds,
-    const bool filter) {
-    
+    Find_scss find) {
     R2Mat X = input;
 
     if(X.get_num_rows() ==1 ){
@@ -237,14 +797,153 @@ void skyscraper_invariant(const R2Mat& input,
     result.reserve(X.get_num_rows());
     while(X.get_num_rows() > 0){
         R2Mat subspace;
-        result.back().emplace_back(find_scss_bruteforce(X, subspaces, subspace, bounds, filter));
+        result.back().emplace_back(find(X, subspace));
         if(result.back().back().d1.get_num_rows() == X.get_num_rows()){
             break;
         } else {
-            X.quotient_by(subspace);
+            quotient(X, subspace);
         }
     }
 }
 
+} // namespace
+
+void skyscraper_invariant(const R2Mat& input,
+    vec<HN_factors>& result,
+    vec<vec<vec<SparseMatrix<int>>>>& subspaces,
+    const pair<r2degree>& bounds,
+    const bool filter) {
+    skyscraper_invariant_with(input, result, bounds, [&](const R2Mat& X, R2Mat& subspace) {
+        return find_scss_bruteforce(X, subspaces, subspace, bounds, filter);
+    });
+}
+
+namespace {
+
+/**
+ * @brief Smallest area per dimension of a subspace of the generators other than the one spanned by rows.
+ * Only searched for at most max_fixed_dim generators, otherwise the area per dimension of rows itself, which leaves no margin.
+ */
+double runner_up_area(const Relation_staircase& staircase, const vec<uint64_t>& rows) {
+    int k = staircase.num_generators();
+    int m = rows.size();
+    if(k > max_fixed_dim){
+        return staircase.area(rows) / m;
+    }
+    double result = INFINITY;
+    vec<uint64_t> both;
+    for(int d = 1; d <= k; d++){
+        Grassmannian_enumerator subspaces(k, d);
+        while(subspaces.advance()){
+            const vec<uint64_t>& basis = subspaces.basis_rows();
+            if(d == m){
+                both = rows;
+                both.insert(both.end(), basis.begin(), basis.end());
+                if(rank_of(both.data(), both.size()) == m){
+                    continue;
+                }
+            }
+            result = std::min(result, staircase.area(basis) / d);
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+bool Shiftable_filtration::compute(const R2Mat& X, const pair<r2degree>& bounds) {
+    valid = false;
+    factors.clear();
+    margins.clear();
+    if(X.get_num_rows() <= 1 || !f2_kernel_applies(X)){
+        return false;
+    }
+    bool bounded = true;
+    vec<HN_factors> result;
+    // The scss chain of the last computation seeds the search at every step, the quotients agree as long as the chain does.
+    vec<vec<uint64_t>> previous_chain = std::move(chain);
+    chain.clear();
+    skyscraper_invariant_with(X, result, bounds, [&](const R2Mat& quotient, R2Mat& subspace) {
+        Relation_staircase staircase(quotient, bounds);
+        static const vec<uint64_t> no_seed;
+        size_t step = chain.size();
+        const vec<uint64_t>& seed_rows = step < previous_chain.size() ? previous_chain[step] : no_seed;
+        Uni_B1 scss = find_scss(quotient, subspace, bounds, false, seed_rows);
+        if(!staircase.bounded()){
+            bounded = false;
+            return scss;
+        }
+        vec<uint64_t> rows = F2_matrix(subspace).columns;
+        chain.push_back(rows);
+        if(rows.empty()){
+            // The scss is the whole quotient.
+            for(int q = 0; q < quotient.get_num_rows(); q++){
+                rows.push_back(uint64_t(1) << q);
+            }
+        }
+        scss.area_polynomial = staircase.area_polynomial(rows);
+        margins.push_back({runner_up_area(staircase, rows), staircase.left_edge_length(), staircase.bottom_edge_length()});
+        return scss;
+    });
+    if(!bounded){
+        return false;
+    }
+    factors = std::move(result.back());
+    generator_degree = X.row_degrees[0];
+    valid = true;
+    return true;
+}
+
+bool Shiftable_filtration::shift(const r2degree& degree, const pair<r2degree>& bounds, HN_factors& result) const {
+    assert(valid);
+    assert(margins.size() == factors.size());
+    r2degree shift = degree - generator_degree;
+    double range_area = (bounds.second.first - bounds.first.first) * (bounds.second.second - bounds.first.second);
+    result = factors;
+    for(size_t i = 0; i < result.size(); i++){
+        result[i].slope_value = result[i].evaluate_slope_polynomial(shift, bounds);
+        // The area of a subspace of dimension e is p[0] + p[1]*x + p[2]*y + e*x*y/range_area, where p[1]/e and p[2]/e
+        // lie between minus the edge lengths and 0. So no other subspace has less area per dimension than others.
+        const Margin& margin = margins[i];
+        double others = margin.runner_up - margin.left_edge * std::max(shift.first, 0.0) 
+            - margin.bottom_edge * std::max(shift.second, 0.0) + shift.first * shift.second / range_area;
+        if(!(result[i].slope_value > 0) || !(1 / result[i].slope_value < others * (1 - 1e-9))){
+            return false;
+        }
+        result[i].d1.set_all_generator_degrees(degree);
+    }
+    return true;
+}
+
+void skyscraper_invariant(const R2Mat& input,
+    vec<HN_factors>& result,
+    const pair<r2degree>& bounds,
+    const bool filter) {
+    if(filter || !hnf_search_config().memo_cache || input.get_num_rows() <= 1 || !f2_kernel_applies(input)){
+        skyscraper_invariant_with(input, result, bounds, [&](const R2Mat& X, R2Mat& subspace) {
+            return find_scss(X, subspace, bounds, filter);
+        });
+        return;
+    }
+    std::string key = HNF_cache::key(input, bounds);
+    HNF_cache::Chain chain;
+    if(HNF_cache::lookup(key, chain)){
+        // The quotients are determined by the relations of input, so the stored rows fit them.
+        size_t step = 0;
+        skyscraper_invariant_with(input, result, bounds, [&](const R2Mat& X, R2Mat& subspace) {
+            assert(step < chain.size());
+            Uni_B1 scss;
+            build_scss(X, chain[step++], scss, subspace, bounds);
+            return scss;
+        });
+        return;
+    }
+    skyscraper_invariant_with(input, result, bounds, [&](const R2Mat& X, R2Mat& subspace) {
+        Uni_B1 scss = find_scss(X, subspace, bounds, filter);
+        chain.push_back(F2_matrix(subspace).columns);
+        return scss;
+    });
+    HNF_cache::insert(key, std::move(chain));
+}
 
 } // namespace hnf
\ No newline at end of file
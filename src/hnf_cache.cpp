@@ -0,0 +1,141 @@
+#include "hnf_cache.hpp"
+#include "f2_matrix.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+
+namespace hnf {
+
+namespace {
+
+template<typename T>
+void append_value(std::string& key, T value) {
+    char bytes[sizeof(T)];
+    std::memcpy(bytes, &value, sizeof(T));
+    key.append(bytes, sizeof(T));
+}
+
+} // namespace
+
+HNF_cache& HNF_cache::instance() {
+    static HNF_cache cache;
+    return cache;
+}
+
+HNF_cache::Shard& HNF_cache::shard_of(const std::string& key) {
+    return instance().shards[std::hash<std::string>()(key) % num_shards];
+}
+
+std::string HNF_cache::key(const R2Mat& X, const pair<r2degree>& bounds) {
+    assert(f2_kernel_applies(X));
+    const r2degree& generator_degree = X.row_degrees[0];
+    int k = X.get_num_rows();
+    struct Relation {
+        r2degree degree;
+        uint64_t vector;
+    };
+    vec<Relation> relations;
+    relations.reserve(X.get_num_cols());
+    for(uint64_t vector : F2_matrix(X).columns){
+        relations.push_back({r2degree(), vector});
+    }
+    for(int j = 0; j < X.get_num_cols(); j++){
+        relations[j].degree = X.col_degrees[j] - generator_degree;
+    }
+
+    // X is bounded if the relations on the horizontal and on the vertical line through the generators already kill everything,
+    // see Relation_staircase. Then its areas only depend on the bounds through the size of the range.
+    F2_echelon_basis horizontal, vertical;
+    for(const Relation& relation : relations){
+        if(relation.degree.second <= 0){
+            horizontal.add(relation.vector);
+        }
+        if(relation.degree.first <= 0){
+            vertical.add(relation.vector);
+        }
+    }
+    bool bounded = horizontal.dim() == k && vertical.dim() == k;
+
+    // Different presentations of the same module have the same span of relations R_p in every degree p.
+    // For every relation degree the key holds the reduced echelon basis of R_p, which does not depend on the presentation.
+    vec<r2degree> degrees;
+    for(const Relation& relation : relations){
+        degrees.push_back(relation.degree);
+    }
+    std::sort(degrees.begin(), degrees.end());
+    degrees.erase(std::unique(degrees.begin(), degrees.end()), degrees.end());
+
+    std::string key;
+    key.reserve(2*sizeof(int32_t) + 4*sizeof(double) + degrees.size() * (2*sizeof(double) + sizeof(int32_t) + k*sizeof(uint64_t)));
+    append_value<int32_t>(key, k);
+    append_value<int32_t>(key, bounded);
+    if(bounded){
+        r2degree range = bounds.second - bounds.first;
+        append_value(key, range.first);
+        append_value(key, range.second);
+    } else {
+        for(const r2degree& bound : {bounds.first, bounds.second}){
+            r2degree relative = bound - generator_degree;
+            append_value(key, relative.first);
+            append_value(key, relative.second);
+        }
+    }
+    for(const r2degree& degree : degrees){
+        F2_echelon_basis span;
+        for(const Relation& relation : relations){
+            if(relation.degree.first <= degree.first && relation.degree.second <= degree.second){
+                span.add(relation.vector);
+            }
+        }
+        append_value(key, degree.first);
+        append_value(key, degree.second);
+        append_value<int32_t>(key, span.dim());
+        for(uint64_t vector : span.vectors){
+            append_value(key, vector);
+        }
+    }
+    return key;
+}
+
+bool HNF_cache::lookup(const std::string& key, Chain& chain) {
+    Shard& shard = shard_of(key);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.chains.find(key);
+        if(it != shard.chains.end()){
+            chain = it->second;
+            instance().num_hits.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+    }
+    instance().num_misses.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void HNF_cache::insert(const std::string& key, Chain chain) {
+    Shard& shard = shard_of(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    if(shard.chains.size() < max_entries_per_shard){
+        shard.chains.emplace(key, std::move(chain));
+    }
+}
+
+size_t HNF_cache::hits() {
+    return instance().num_hits.load(std::memory_order_relaxed);
+}
+
+size_t HNF_cache::misses() {
+    return instance().num_misses.load(std::memory_order_relaxed);
+}
+
+void HNF_cache::print_statistics() {
+    size_t total = hits() + misses();
+    std::cout << "HNF cache: " << hits() << " hits, " << misses() << " misses";
+    if(total > 0){
+        std::cout << " (hit rate " << 100.0 * hits() / total << "%)";
+    }
+    std::cout << std::endl;
+}
+
+} // namespace hnf
@@ -0,0 +1,246 @@
+#include "region_file.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <regex>
+#include <sstream>
+#include <stdexcept>
+
+namespace hnf {
+
+namespace {
+
+std::vector<std::string> split(const std::string& line, char separator) {
+    std::vector<std::string> tokens;
+    std::istringstream iss(line);
+    std::string token;
+    while (std::getline(iss, token, separator)) {
+        tokens.push_back(token);
+    }
+    return tokens;
+}
+
+std::pair<double, double> parse_pair(std::string token) {
+    token.erase(std::remove(token.begin(), token.end(), '('), token.end());
+    token.erase(std::remove(token.begin(), token.end(), ')'), token.end());
+    size_t semicolon = token.find(';');
+    if (semicolon == std::string::npos) {
+        throw std::runtime_error("Malformed point: " + token);
+    }
+    return {std::stod(token.substr(0, semicolon)), std::stod(token.substr(semicolon + 1))};
+}
+
+std::string next_line(std::ifstream& file) {
+    std::string line;
+    if (!std::getline(file, line)) {
+        throw std::runtime_error("Region file ends in the middle of a record");
+    }
+    return line;
+}
+
+Region_subdivision read_subdivision(std::ifstream& file) {
+    std::string line = next_line(file);
+    if (line.substr(0, 2) != "D,") {
+        throw std::runtime_error("Expected a region record, got: " + line);
+    }
+    Region_subdivision subdivision;
+    subdivision.faces.resize(std::stoi(line.substr(2)));
+    for (Region_face& face : subdivision.faces) {
+        // F,dim,a0,a1,a2,num_intervals,has_quotient,num_vertices,x;y,...
+        std::vector<std::string> tokens = split(next_line(file), ',');
+        if (tokens.size() < 8 || tokens[0] != "F") {
+            throw std::runtime_error("Malformed face record");
+        }
+        face.dim = std::stoi(tokens[1]);
+        for (int i = 0; i < 3; i++) {
+            face.area_polynomial[i] = std::stod(tokens[2 + i]);
+        }
+        int num_intervals = std::stoi(tokens[5]);
+        bool has_quotient = std::stoi(tokens[6]) != 0;
+        size_t num_vertices = std::stoul(tokens[7]);
+        if (tokens.size() != 8 + num_vertices) {
+            throw std::runtime_error("Face record has the wrong number of vertices");
+        }
+        for (size_t v = 0; v < num_vertices; v++) {
+            face.vertices.push_back(parse_pair(tokens[8 + v]));
+        }
+        for (int i = 0; i < num_intervals; i++) {
+            std::vector<std::string> relations = split(next_line(file), ',');
+            face.intervals.emplace_back();
+            for (size_t r = 1; r < relations.size(); r++) {
+                face.intervals.back().push_back(parse_pair(relations[r]));
+            }
+        }
+        if (has_quotient) {
+            face.quotient = std::make_unique<Region_subdivision>(read_subdivision(file));
+        }
+    }
+    return subdivision;
+}
+
+bool contains(const Region_face& face, double x, double y) {
+    const auto& v = face.vertices;
+    double scale = 0;
+    for (const auto& [vx, vy] : v) {
+        scale = std::max({scale, std::abs(vx), std::abs(vy)});
+    }
+    const double tolerance = 1e-9 * (1 + scale) * (1 + scale);
+    for (size_t i = 0; i < v.size(); i++) {
+        const auto& a = v[i];
+        const auto& b = v[(i + 1) % v.size()];
+        double cross = (b.first - a.first) * (y - a.second) - (b.second - a.second) * (x - a.first);
+        if (cross < -tolerance) {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct Sampled_factor {
+    double slope;
+    const std::vector<std::pair<double, double>>* relations;
+};
+
+/**
+ * @brief Appends the factors of the filtration at the shift (x,y), returns false if some region does not contain it.
+ */
+bool sample(const Region_subdivision& subdivision, double x, double y, double range_area, std::vector<Sampled_factor>& factors) {
+    for (const Region_face& face : subdivision.faces) {
+        if (!contains(face, x, y)) continue;
+        const auto& p = face.area_polynomial;
+        double slope = face.dim / (p[0] + p[1]*x + p[2]*y + face.dim*x*y/range_area);
+        for (const auto& interval : face.intervals) {
+            factors.push_back({slope, &interval});
+        }
+        return !face.quotient || sample(*face.quotient, x, y, range_area, factors);
+    }
+    return false;
+}
+
+/**
+ * @brief Range [first, last) of the grid indices whose coordinates start + (offset + i)*step lie in [begin, end).
+ */
+std::pair<int, int> covered_indices(double begin, double end, double start, double offset, double step, int n) {
+    auto coordinate = [&](int i) { return start + (offset + i) * step; };
+    int first = std::max(0, static_cast<int>(std::floor((begin - start) / step - offset)));
+    while (first < n && coordinate(first) < begin) first++;
+    while (first > 0 && coordinate(first - 1) >= begin) first--;
+    int last = first;
+    while (last < n && coordinate(last) < end) last++;
+    return {first, last};
+}
+
+} // namespace
+
+Region_data regions_from_file(const std::string& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+    Region_data result;
+    std::string line;
+
+    // Line 1: Must be "HNR"
+    std::getline(file, line);
+    if (line.find("HNR") == std::string::npos) {
+        throw std::runtime_error("First line must be 'HNR'");
+    }
+
+    // Line 2: bounds of the grid and of the slopes
+    std::getline(file, line);
+    std::regex coord_regex(R"(\((-?[0-9.eE+-]+),\s*(-?[0-9.eE+-]+)\))");
+    std::vector<std::pair<double, double>> coords;
+    for (auto it = std::sregex_iterator(line.begin(), line.end(), coord_regex); it != std::sregex_iterator(); ++it) {
+        coords.push_back({std::stod((*it)[1]), std::stod((*it)[2])});
+    }
+    if (coords.size() < 4) {
+        throw std::runtime_error("Expected 4 coordinate pairs");
+    }
+    result.lower_bound = coords[0];
+    result.upper_bound = coords[1];
+    result.slope_lower_bound = coords[2];
+    result.slope_upper_bound = coords[3];
+
+    Region_cell* cell = nullptr;
+    while (file.peek() != EOF) {
+        std::streampos position = file.tellg();
+        if (!std::getline(file, line) || line.empty()) continue;
+        if (line.substr(0, 2) == "C,") {
+            std::vector<std::string> tokens = split(line, ',');
+            if (tokens.size() != 6) {
+                throw std::runtime_error("Malformed cell record: " + line);
+            }
+            result.cells.emplace_back();
+            cell = &result.cells.back();
+            cell->summand = std::stoi(tokens[1]);
+            cell->start = {std::stod(tokens[2]), std::stod(tokens[3])};
+            cell->end = {std::stod(tokens[4]), std::stod(tokens[5])};
+        } else {
+            if (!cell) {
+                throw std::runtime_error("Region record outside of a cell");
+            }
+            file.seekg(position);
+            cell->summands.push_back(read_subdivision(file));
+        }
+    }
+    std::cout << "Loaded the regions of " << result.cells.size() << " local cells." << std::endl;
+    return result;
+}
+
+size_t rasterise_regions(const Region_data& regions, int n_x, int n_y, std::ostream& ostream) {
+    const auto& lower = regions.lower_bound;
+    const auto& upper = regions.upper_bound;
+    double step_x = (upper.first - lower.first) / (n_x - 1);
+    double step_y = (upper.second - lower.second) / (n_y - 1);
+    double range_area = (regions.slope_upper_bound.first - regions.slope_lower_bound.first)
+        * (regions.slope_upper_bound.second - regions.slope_lower_bound.second);
+
+    // Same grid points as process_grid_row.
+    const double offset_x = 0.001;
+    std::vector<std::vector<Sampled_factor>> factors(static_cast<size_t>(n_x) * n_y);
+    std::vector<bool> missed(factors.size(), false);
+    for (const Region_cell& cell : regions.cells) {
+        auto [i_begin, i_end] = covered_indices(cell.start.first, cell.end.first, lower.first, offset_x, step_x, n_x);
+        auto [j_begin, j_end] = covered_indices(cell.start.second, cell.end.second, lower.second, 0, step_y, n_y);
+        for (int j = j_begin; j < j_end; j++) {
+            double y = lower.second + j * step_y - cell.start.second;
+            for (int i = i_begin; i < i_end; i++) {
+                double x = lower.first + (offset_x + i) * step_x - cell.start.first;
+                size_t index = static_cast<size_t>(j) * n_x + i;
+                for (const Region_subdivision& summand : cell.summands) {
+                    if (!sample(summand, x, y, range_area, factors[index])) {
+                        missed[index] = true;
+                    }
+                }
+            }
+        }
+    }
+
+    ostream << std::fixed << std::setprecision(8);
+    ostream << "HNF" << "\n";
+    ostream << n_x << "," << n_y << "\n";
+    ostream << "(" << lower.first << ", " << lower.second << "),(" << upper.first << ", " << upper.second
+        << "),(" << step_x << ", " << step_y << ")" << "\n";
+    for (int j = 0; j < n_y; j++) {
+        for (int i = 0; i < n_x; i++) {
+            std::vector<Sampled_factor>& filtration = factors[static_cast<size_t>(j) * n_x + i];
+            std::stable_sort(filtration.begin(), filtration.end(), [](const Sampled_factor& a, const Sampled_factor& b) {
+                return a.slope > b.slope;
+            });
+            ostream << "G," << i << "," << j << ", (" << lower.first + (offset_x + i) * step_x << ", "
+                << lower.second + j * step_y << ")" << "\n";
+            for (const Sampled_factor& factor : filtration) {
+                ostream << factor.slope;
+                for (const auto& [x, y] : *factor.relations) {
+                    ostream << "," << "(" << x << ";" << y << ")";
+                }
+                ostream << "\n";
+            }
+        }
+    }
+    return std::count(missed.begin(), missed.end(), true);
+}
+
+} // namespace hnf
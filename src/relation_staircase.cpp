@@ -0,0 +1,167 @@
+#include "relation_staircase.hpp"
+#include <algorithm>
+#include <map>
+
+namespace hnf {
+
+Relation_staircase::Relation_staircase(const R2Mat& X, const pair<r2degree>& bounds) : k(X.get_num_rows()) {
+    assert(k <= 64);
+    r2degree range = bounds.second - bounds.first;
+    double range_area = range.first * range.second;
+    const r2degree& generator_degree = X.row_degrees[0];
+
+    struct Relation {
+        r2degree degree;
+        uint64_t vector;
+    };
+    vec<Relation> relations;
+    for(int j = 0; j < X.get_num_cols(); j++){
+        uint64_t vector = 0;
+        for(int row : X.data[j]){
+            vector |= uint64_t(1) << row;
+        }
+        relations.push_back({X.col_degrees[j], vector});
+    }
+    std::sort(relations.begin(), relations.end(), [](const Relation& a, const Relation& b) {
+        return a.degree.second < b.degree.second;
+    });
+
+    vec<double> xs = {generator_degree.first};
+    vec<double> ys = {generator_degree.second};
+    for(const Relation& relation : relations){
+        xs.push_back(std::max(relation.degree.first, generator_degree.first));
+        ys.push_back(std::max(relation.degree.second, generator_degree.second));
+    }
+    std::sort(xs.begin(), xs.end());
+    xs.erase(std::unique(xs.begin(), xs.end()), xs.end());
+    std::sort(ys.begin(), ys.end());
+    ys.erase(std::unique(ys.begin(), ys.end()), ys.end());
+
+    std::map<vec<uint64_t>, int> group_of_span;
+    for(size_t a = 0; a < xs.size(); a++){
+        F2_echelon_basis span;
+        size_t next_relation = 0;
+        for(size_t b = 0; b < ys.size(); b++){
+            while(next_relation < relations.size() && relations[next_relation].degree.second <= ys[b]){
+                if(relations[next_relation].degree.first <= xs[a]){
+                    span.add(relations[next_relation].vector);
+                }
+                next_relation++;
+            }
+            if(span.dim() == k){
+                // Nothing of X is left above this cell in y direction.
+                break;
+            }
+            if(a + 1 == xs.size() || b + 1 == ys.size()){
+                is_bounded = false;
+                return;
+            }
+            double cell_area = (xs[a+1] - xs[a]) * (ys[b+1] - ys[b]) / range_area;
+            if(span.vectors.empty()){
+                no_relations_area += cell_area;
+            }
+            auto [it, inserted] = group_of_span.try_emplace(span.vectors, group_areas.size());
+            if(inserted){
+                group_areas.push_back(0);
+                for(int q = 0; q < k; q++){
+                    reduced_generators.push_back(span.normal_form(uint64_t(1) << q));
+                }
+            }
+            group_areas[it->second] += cell_area;
+            if(a == 0){
+                left_edge.emplace_back(it->second, (ys[b+1] - ys[b]) / range_area);
+            }
+            if(b == 0){
+                bottom_edge.emplace_back(it->second, (xs[a+1] - xs[a]) / range_area);
+            }
+        }
+    }
+}
+
+double Relation_staircase::area(const vec<uint64_t>& rows) const {
+    int d = rows.size();
+    vec<uint64_t> reduced(d);
+    double result = 0;
+    for(int g = 0; g < num_groups(); g++){
+        for(int r = 0; r < d; r++){
+            uint64_t v = 0;
+            for(uint64_t bits = rows[r]; bits != 0; bits &= bits - 1){
+                v ^= reduced_generator(g, __builtin_ctzll(bits));
+            }
+            reduced[r] = v;
+        }
+        result += group_areas[g] * rank_of(reduced.data(), d);
+    }
+    return result;
+}
+
+std::array<double, 3> Relation_staircase::area_polynomial(const vec<uint64_t>& rows) const {
+    int d = rows.size();
+    vec<int> ranks(num_groups());
+    vec<uint64_t> reduced(d);
+    for(int g = 0; g < num_groups(); g++){
+        for(int r = 0; r < d; r++){
+            uint64_t v = 0;
+            for(uint64_t bits = rows[r]; bits != 0; bits &= bits - 1){
+                v ^= reduced_generator(g, __builtin_ctzll(bits));
+            }
+            reduced[r] = v;
+        }
+        ranks[g] = rank_of(reduced.data(), d);
+    }
+    // Moving the generators right by x cuts off a strip of width x along the left edge, and similarly for y.
+    std::array<double, 3> polynomial = {0, 0, 0};
+    for(int g = 0; g < num_groups(); g++){
+        polynomial[0] += group_areas[g] * ranks[g];
+    }
+    for(const auto& [g, length] : left_edge){
+        polynomial[1] -= length * ranks[g];
+    }
+    for(const auto& [g, length] : bottom_edge){
+        polynomial[2] -= length * ranks[g];
+    }
+    return polynomial;
+}
+
+double Relation_staircase::left_edge_length() const {
+    double length = 0;
+    for(const auto& edge : left_edge){
+        length += edge.second;
+    }
+    return length;
+}
+
+double Relation_staircase::bottom_edge_length() const {
+    double length = 0;
+    for(const auto& edge : bottom_edge){
+        length += edge.second;
+    }
+    return length;
+}
+
+Subspace_area::Subspace_area(const Relation_staircase& staircase, const vec<uint64_t>& rows)
+    : staircase(staircase), d(rows.size()), reduced_rows(staircase.num_groups() * rows.size(), 0) {
+    for(int g = 0; g < staircase.num_groups(); g++){
+        for(int r = 0; r < d; r++){
+            for(uint64_t bits = rows[r]; bits != 0; bits &= bits - 1){
+                reduced_rows[g * d + r] ^= staircase.reduced_generator(g, __builtin_ctzll(bits));
+            }
+        }
+    }
+}
+
+void Subspace_area::flip(int row, int column) {
+    for(int g = 0; g < staircase.num_groups(); g++){
+        reduced_rows[g * d + row] ^= staircase.reduced_generator(g, column);
+    }
+}
+
+double Subspace_area::area() const {
+    double result = 0;
+    for(int g = 0; g < staircase.num_groups(); g++){
+        result += staircase.group_area(g) * rank_of(reduced_rows.data() + g * d, d);
+    }
+    return result;
+}
+
+} // namespace hnf
@@ -0,0 +1,397 @@
+#include "sky_binary.hpp"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iomanip>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace hnf {
+
+namespace {
+
+// Layout of a binary .skb file, all numbers little endian as written by the machine:
+//   magic "SKYB", uint32 version, int32 n_x, int32 n_y,
+//   lower bound, upper bound and grid step as pairs of float64,
+//   one record per cell: float64 x, float64 y, uint64 number of factors,
+//     and for each factor float64 slope, uint64 number of relations, then the relations as pairs of float64,
+//   the index: uint64 byte offset of the cell (i, j) at position j*n_x + i, 0 for cells without a record,
+//   and finally the uint64 byte offset of the index.
+const char sky_magic[4] = {'S','K','Y','B'};
+const uint32_t sky_version = 1;
+const size_t sky_header_size = sizeof(sky_magic) + 3*sizeof(uint32_t) + 6*sizeof(double);
+
+template<typename T>
+void append_value(std::vector<char>& bytes, T value) {
+    char raw[sizeof(T)];
+    std::memcpy(raw, &value, sizeof(T));
+    bytes.insert(bytes.end(), raw, raw + sizeof(T));
+}
+
+double parse_double(const char*& p) {
+    char* end;
+    double value = std::strtod(p, &end);
+    if(end == p){
+        throw std::runtime_error("Expected a number in .sky line at: " + std::string(p));
+    }
+    p = end;
+    return value;
+}
+
+void expect(const char*& p, char c) {
+    while(*p == ' ' || *p == '\t'){
+        p++;
+    }
+    if(*p != c){
+        throw std::runtime_error(std::string("Expected '") + c + "' in .sky line at: " + std::string(p));
+    }
+    p++;
+}
+
+// Reads "(x, y)" or "(x;y)".
+std::pair<double, double> parse_point(const char*& p, char separator) {
+    expect(p, '(');
+    double x = parse_double(p);
+    expect(p, separator);
+    double y = parse_double(p);
+    expect(p, ')');
+    return {x, y};
+}
+
+} // namespace
+
+Sky_binary_builder::Sky_binary_builder(std::ostream& out) : out(out) {}
+
+void Sky_binary_builder::header(int n_x, int n_y,
+    const std::pair<double, double>& lower_bound,
+    const std::pair<double, double>& upper_bound,
+    const std::pair<double, double>& grid_step) {
+    this->n_x = n_x;
+    this->n_y = n_y;
+    offsets.assign(static_cast<size_t>(n_x) * n_y, 0);
+    std::vector<char> bytes(sky_magic, sky_magic + sizeof(sky_magic));
+    append_value<uint32_t>(bytes, sky_version);
+    append_value<int32_t>(bytes, n_x);
+    append_value<int32_t>(bytes, n_y);
+    for(const auto& point : {lower_bound, upper_bound, grid_step}){
+        append_value(bytes, point.first);
+        append_value(bytes, point.second);
+    }
+    out.write(bytes.data(), bytes.size());
+    position = bytes.size();
+}
+
+void Sky_binary_builder::write_cell() {
+    if(current == -1){
+        return;
+    }
+    // The number of factors is only known now.
+    std::memcpy(record.data() + 2*sizeof(double), &num_factors, sizeof(uint64_t));
+    offsets[current] = position;
+    out.write(record.data(), record.size());
+    position += record.size();
+    current = -1;
+}
+
+void Sky_binary_builder::cell(int i, int j, double x, double y) {
+    if(i < 0 || i >= n_x || j < 0 || j >= n_y){
+        throw std::runtime_error("Grid point (" + std::to_string(i) + ", " + std::to_string(j) + ") outside of the grid");
+    }
+    write_cell();
+    current = j * n_x + i;
+    num_factors = 0;
+    record.clear();
+    append_value(record, x);
+    append_value(record, y);
+    append_value<uint64_t>(record, 0);
+}
+
+void Sky_binary_builder::factor(double slope, const std::vector<std::pair<double, double>>& relations) {
+    if(current == -1){
+        throw std::runtime_error("Factor outside of a grid point");
+    }
+    append_value(record, slope);
+    append_value<uint64_t>(record, relations.size());
+    for(const auto& [x, y] : relations){
+        append_value(record, x);
+        append_value(record, y);
+    }
+    num_factors++;
+}
+
+void Sky_binary_builder::finish() {
+    if(finished){
+        return;
+    }
+    finished = true;
+    write_cell();
+    uint64_t index_offset = position;
+    std::vector<char> bytes;
+    bytes.reserve((offsets.size() + 1) * sizeof(uint64_t));
+    for(uint64_t offset : offsets){
+        append_value(bytes, offset);
+    }
+    append_value(bytes, index_offset);
+    out.write(bytes.data(), bytes.size());
+    position += bytes.size();
+}
+
+Sky_text_writer::Sky_text_writer(std::ostream& out) : out(out) {
+    out << std::fixed << std::setprecision(8);
+}
+
+// Same format as write_grid_metadata and write_filtration.
+void Sky_text_writer::header(int n_x, int n_y,
+    const std::pair<double, double>& lower_bound,
+    const std::pair<double, double>& upper_bound,
+    const std::pair<double, double>& grid_step) {
+    out << "HNF" << "\n";
+    out << n_x << "," << n_y << "\n";
+    out << "(" << lower_bound.first << ", " << lower_bound.second << "),";
+    out << "(" << upper_bound.first << ", " << upper_bound.second << "),";
+    out << "(" << grid_step.first << ", " << grid_step.second << ")" << "\n";
+}
+
+void Sky_text_writer::cell(int i, int j, double x, double y) {
+    out << "G," << i << "," << j << ", " << "(" << x << ", " << y << ")" << "\n";
+}
+
+void Sky_text_writer::factor(double slope, const std::vector<std::pair<double, double>>& relations) {
+    out << slope;
+    for(const auto& [x, y] : relations){
+        out << "," << "(" << x << ";" << y << ")";
+    }
+    out << "\n";
+}
+
+void Sky_text_writer::finish() {
+    out.flush();
+}
+
+void Sky_text_parser::line(const std::string& line) {
+    const char* p = line.c_str();
+    while(*p == ' ' || *p == '\t'){
+        p++;
+    }
+    if(*p == '\0' || *p == '\r'){
+        return;
+    }
+    line_number++;
+    if(line_number == 1){
+        if(std::strncmp(p, "HNF", 3) != 0){
+            throw std::runtime_error("First line must be 'HNF'");
+        }
+    } else if(line_number == 2){
+        if(std::sscanf(p, "%d,%d", &n_x, &n_y) != 2 || n_x < 1 || n_y < 1){
+            throw std::runtime_error("Malformed grid dimensions: " + line);
+        }
+    } else if(line_number == 3){
+        auto lower_bound = parse_point(p, ',');
+        expect(p, ',');
+        auto upper_bound = parse_point(p, ',');
+        expect(p, ',');
+        auto grid_step = parse_point(p, ',');
+        sink.header(n_x, n_y, lower_bound, upper_bound, grid_step);
+    } else if(p[0] == 'G' && p[1] == ','){
+        p += 2;
+        char* end;
+        int i = std::strtol(p, &end, 10);
+        p = end;
+        expect(p, ',');
+        int j = std::strtol(p, &end, 10);
+        p = end;
+        expect(p, ',');
+        auto point = parse_point(p, ',');
+        sink.cell(i, j, point.first, point.second);
+    } else {
+        double slope = parse_double(p);
+        std::vector<std::pair<double, double>> relations;
+        while(*p == ','){
+            p++;
+            relations.push_back(parse_point(p, ';'));
+        }
+        sink.factor(slope, relations);
+    }
+}
+
+Sky_binary_file::Sky_binary_file(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd == -1){
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < sky_header_size + sizeof(uint64_t)){
+        close(fd);
+        throw std::runtime_error("Not a binary .sky file: " + filename);
+    }
+    size = file_stat.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED){
+        throw std::runtime_error("Cannot map file: " + filename);
+    }
+    data = static_cast<const char*>(mapped);
+    // The destructor does not run if the constructor throws.
+    auto fail = [&](const std::string& message) {
+        munmap(const_cast<char*>(data), size);
+        data = nullptr;
+        throw std::runtime_error(message + filename);
+    };
+
+    size_t position = sizeof(sky_magic);
+    uint32_t version;
+    std::memcpy(&version, data + position, sizeof(uint32_t));
+    position += sizeof(uint32_t);
+    if(std::memcmp(data, sky_magic, sizeof(sky_magic)) != 0 || version != sky_version){
+        fail("Not a binary .sky file of this version: ");
+    }
+    int32_t dimensions[2];
+    std::memcpy(dimensions, data + position, sizeof(dimensions));
+    position += sizeof(dimensions);
+    n_x = dimensions[0];
+    n_y = dimensions[1];
+    for(auto* point : {&lower_bound, &upper_bound, &grid_step}){
+        point->first = read_double(position);
+        point->second = read_double(position);
+    }
+    size_t trailer = size - sizeof(uint64_t);
+    index_offset = read_u64(trailer);
+    if(n_x < 1 || n_y < 1 || index_offset < sky_header_size || index_offset > size - sizeof(uint64_t)
+        || static_cast<size_t>(n_x) * n_y > (size - sizeof(uint64_t) - index_offset) / sizeof(uint64_t)){
+        fail("Binary .sky file is truncated: ");
+    }
+    // for_each_factor and grid_point read the records without checks, so every record has to end before the index.
+    for(int j = 0; j < n_y; j++){
+        for(int i = 0; i < n_x; i++){
+            uint64_t offset = cell_offset(i, j);
+            if(offset != 0 && !valid_record(offset)){
+                fail("Binary .sky file has a corrupt record of the cell (" + std::to_string(i) + ", " + std::to_string(j) + ") in: ");
+            }
+        }
+    }
+}
+
+bool Sky_binary_file::valid_record(uint64_t offset) const {
+    if(offset < sky_header_size || offset > index_offset || index_offset - offset < 2*sizeof(double) + sizeof(uint64_t)){
+        return false;
+    }
+    size_t position = offset + 2*sizeof(double);
+    uint64_t num_factors = read_u64(position);
+    // Every factor takes at least its slope and its number of relations.
+    if(num_factors > (index_offset - position) / (sizeof(double) + sizeof(uint64_t))){
+        return false;
+    }
+    for(uint64_t s = 0; s < num_factors; s++){
+        if(index_offset - position < sizeof(double) + sizeof(uint64_t)){
+            return false;
+        }
+        position += sizeof(double);
+        uint64_t num_relations = read_u64(position);
+        if(num_relations > (index_offset - position) / (2*sizeof(double))){
+            return false;
+        }
+        position += num_relations * 2*sizeof(double);
+    }
+    return true;
+}
+
+Sky_binary_file::~Sky_binary_file() {
+    if(data != nullptr){
+        munmap(const_cast<char*>(data), size);
+    }
+}
+
+bool Sky_binary_file::is_binary(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    char magic[sizeof(sky_magic)];
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, sky_magic, sizeof(sky_magic)) == 0;
+}
+
+uint64_t Sky_binary_file::read_u64(size_t& position) const {
+    uint64_t value;
+    std::memcpy(&value, data + position, sizeof(uint64_t));
+    position += sizeof(uint64_t);
+    return value;
+}
+
+double Sky_binary_file::read_double(size_t& position) const {
+    double value;
+    std::memcpy(&value, data + position, sizeof(double));
+    position += sizeof(double);
+    return value;
+}
+
+void Sky_cell_buffer::cell(int i, int j, double x, double y) {
+    cells.push_back({i, j, x, y, factors.size()});
+}
+
+void Sky_cell_buffer::factor(double slope, const std::vector<std::pair<double, double>>& relations) {
+    if(cells.empty()){
+        throw std::runtime_error("Factor outside of a grid point");
+    }
+    factors.push_back({slope, this->relations.size()});
+    this->relations.insert(this->relations.end(), relations.begin(), relations.end());
+}
+
+void Sky_cell_buffer::replay(Sky_cell_sink& sink) const {
+    std::vector<std::pair<double, double>> factor_relations;
+    for(size_t c = 0; c < cells.size(); c++){
+        const Cell& cell = cells[c];
+        sink.cell(cell.i, cell.j, cell.x, cell.y);
+        size_t factor_end = c + 1 < cells.size() ? cells[c+1].first_factor : factors.size();
+        for(size_t f = cell.first_factor; f < factor_end; f++){
+            size_t relation_end = f + 1 < factors.size() ? factors[f+1].first_relation : relations.size();
+            factor_relations.assign(relations.begin() + factors[f].first_relation, relations.begin() + relation_end);
+            sink.factor(factors[f].slope, factor_relations);
+        }
+    }
+}
+
+uint64_t Sky_binary_file::cell_offset(int i, int j) const {
+    size_t position = index_offset + (static_cast<size_t>(j) * n_x + i) * sizeof(uint64_t);
+    return read_u64(position);
+}
+
+bool Sky_binary_file::has_cell(int i, int j) const {
+    return i >= 0 && i < n_x && j >= 0 && j < n_y && cell_offset(i, j) != 0;
+}
+
+std::pair<double, double> Sky_binary_file::grid_point(int i, int j) const {
+    size_t position = cell_offset(i, j);
+    double x = read_double(position);
+    double y = read_double(position);
+    return {x, y};
+}
+
+void sky_text_to_binary(const std::string& input, const std::string& output) {
+    std::ifstream in(input);
+    if(!in.is_open()){
+        throw std::runtime_error("Cannot open file: " + input);
+    }
+    std::ofstream out(output, std::ios::binary);
+    if(!out.is_open()){
+        throw std::runtime_error("Cannot open output file: " + output);
+    }
+    Sky_binary_builder builder(out);
+    Sky_text_parser parser(builder);
+    std::string line;
+    while(std::getline(in, line)){
+        parser.line(line);
+    }
+    builder.finish();
+}
+
+void sky_binary_to_text(const std::string& input, const std::string& output) {
+    Sky_binary_file file(input);
+    std::ofstream out(output);
+    if(!out.is_open()){
+        throw std::runtime_error("Cannot open output file: " + output);
+    }
+    Sky_text_writer writer(out);
+    replay_cells(file, writer);
+}
+
+} // namespace hnf
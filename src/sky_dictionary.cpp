@@ -0,0 +1,351 @@
+#include "sky_dictionary.hpp"
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace hnf {
+
+namespace {
+
+// Layout of a dictionary encoded .skd file, all numbers little endian as written by the machine:
+//   magic "SKYD", uint32 version, int32 n_x, int32 n_y,
+//   lower bound, upper bound and grid step as pairs of float64,
+//   one record per run of equal cells in a row: int32 i, int32 j, uint32 length of the run, uint32 flags,
+//     if the flag stored_point is set the grid point of the first cell and the step to the next cell as pairs of float64,
+//     otherwise they continue the previous run, then uint32 number of factors,
+//     and for each factor uint32 staircase id and float64 slope,
+//   the dictionary: uint64 number of staircases, and for each uint32 number of relations, then the relations as pairs of float64,
+//   and finally the uint64 byte offset of the dictionary.
+const char dictionary_magic[4] = {'S','K','Y','D'};
+const uint32_t dictionary_version = 2;
+const size_t dictionary_header_size = sizeof(dictionary_magic) + 3*sizeof(uint32_t) + 6*sizeof(double);
+const size_t factor_size = sizeof(uint32_t) + sizeof(double);
+const size_t run_header_size = 5*sizeof(uint32_t);
+const uint32_t stored_point = 1;
+
+template<typename T>
+void append_value(std::vector<char>& bytes, T value) {
+    char raw[sizeof(T)];
+    std::memcpy(raw, &value, sizeof(T));
+    bytes.insert(bytes.end(), raw, raw + sizeof(T));
+}
+
+// The grid point after point, as the sweep computes it by adding the step in every cell.
+std::pair<double, double> next_point(const std::pair<double, double>& point, const std::pair<double, double>& step) {
+    return {point.first + step.first, point.second + step.second};
+}
+
+} // namespace
+
+Sky_dictionary_builder::Sky_dictionary_builder(std::ostream& out) : out(out) {}
+
+void Sky_dictionary_builder::header(int n_x, int n_y,
+    const std::pair<double, double>& lower_bound,
+    const std::pair<double, double>& upper_bound,
+    const std::pair<double, double>& grid_step) {
+    this->n_x = n_x;
+    this->n_y = n_y;
+    this->grid_step = grid_step;
+    std::vector<char> bytes(dictionary_magic, dictionary_magic + sizeof(dictionary_magic));
+    append_value<uint32_t>(bytes, dictionary_version);
+    append_value<int32_t>(bytes, n_x);
+    append_value<int32_t>(bytes, n_y);
+    for(const auto& point : {lower_bound, upper_bound, grid_step}){
+        append_value(bytes, point.first);
+        append_value(bytes, point.second);
+    }
+    out.write(bytes.data(), bytes.size());
+    position = bytes.size();
+}
+
+void Sky_dictionary_builder::write_run() {
+    if(run_length == 0){
+        return;
+    }
+    std::vector<char> bytes;
+    bytes.reserve(run_header_size + 4*sizeof(double));
+    append_value<int32_t>(bytes, run_i);
+    append_value<int32_t>(bytes, run_j);
+    append_value<uint32_t>(bytes, run_length);
+    append_value<uint32_t>(bytes, run_stores_point ? stored_point : 0);
+    if(run_stores_point){
+        for(const auto& point : {run_point, run_step}){
+            append_value(bytes, point.first);
+            append_value(bytes, point.second);
+        }
+    }
+    append_value<uint32_t>(bytes, run_factors.size() / factor_size);
+    out.write(bytes.data(), bytes.size());
+    out.write(run_factors.data(), run_factors.size());
+    position += bytes.size() + run_factors.size();
+    run_length = 0;
+}
+
+void Sky_dictionary_builder::close_cell() {
+    if(cell_i == -1){
+        return;
+    }
+    bool adjacent = run_length > 0 && cell_j == run_j && cell_i == run_i + static_cast<int>(run_length);
+    bool extends = adjacent && cell_factors == run_factors;
+    if(extends && run_length == 1 && run_stores_point){
+        // The step is fixed by the second cell. The grid step of the header reproduces the sweep's sums,
+        // the difference of the points is the fallback for files written otherwise.
+        auto step_between = [&](double from, double to) {
+            for(double candidate : {0.0, grid_step.first, grid_step.second}){
+                if(from + candidate == to){
+                    return candidate;
+                }
+            }
+            return to - from;
+        };
+        run_step = {step_between(run_point.first, cell_point.first), step_between(run_point.second, cell_point.second)};
+    }
+    // The reader recomputes the grid points of a run, so it is only extended if they come out exactly.
+    if(extends && next_point(last_point, run_step) == cell_point){
+        run_length++;
+    } else {
+        // A run right after the last one in its row usually continues its grid points.
+        bool continues = adjacent && next_point(last_point, run_step) == cell_point;
+        write_run();
+        run_i = cell_i;
+        run_j = cell_j;
+        run_length = 1;
+        run_stores_point = !continues;
+        if(run_stores_point){
+            run_point = cell_point;
+            run_step = {0, 0};
+        }
+        run_factors.swap(cell_factors);
+    }
+    last_point = cell_point;
+    cell_i = -1;
+}
+
+void Sky_dictionary_builder::cell(int i, int j, double x, double y) {
+    if(i < 0 || i >= n_x || j < 0 || j >= n_y){
+        throw std::runtime_error("Grid point (" + std::to_string(i) + ", " + std::to_string(j) + ") outside of the grid");
+    }
+    close_cell();
+    cell_i = i;
+    cell_j = j;
+    cell_point = {x, y};
+    cell_factors.clear();
+}
+
+void Sky_dictionary_builder::factor(double slope, const std::vector<std::pair<double, double>>& relations) {
+    if(cell_i == -1){
+        throw std::runtime_error("Factor outside of a grid point");
+    }
+    key.clear();
+    for(const auto& [x, y] : relations){
+        key.append(reinterpret_cast<const char*>(&x), sizeof(double));
+        key.append(reinterpret_cast<const char*>(&y), sizeof(double));
+    }
+    auto [it, inserted] = ids.emplace(key, static_cast<uint32_t>(ids.size()));
+    if(inserted){
+        append_value<uint32_t>(dictionary, relations.size());
+        dictionary.insert(dictionary.end(), key.begin(), key.end());
+    }
+    append_value<uint32_t>(cell_factors, it->second);
+    append_value(cell_factors, slope);
+}
+
+void Sky_dictionary_builder::finish() {
+    if(finished){
+        return;
+    }
+    finished = true;
+    close_cell();
+    write_run();
+    uint64_t dictionary_offset = position;
+    std::vector<char> bytes;
+    append_value<uint64_t>(bytes, ids.size());
+    out.write(bytes.data(), bytes.size());
+    out.write(dictionary.data(), dictionary.size());
+    bytes.clear();
+    append_value(bytes, dictionary_offset);
+    out.write(bytes.data(), bytes.size());
+    position += 2*sizeof(uint64_t) + dictionary.size();
+}
+
+Sky_dictionary_file::Sky_dictionary_file(const std::string& filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if(fd == -1){
+        throw std::runtime_error("Cannot open file: " + filename);
+    }
+    struct stat file_stat;
+    if(fstat(fd, &file_stat) != 0 || static_cast<size_t>(file_stat.st_size) < dictionary_header_size + 2*sizeof(uint64_t)){
+        close(fd);
+        throw std::runtime_error("Not a dictionary encoded .sky file: " + filename);
+    }
+    size = file_stat.st_size;
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(mapped == MAP_FAILED){
+        throw std::runtime_error("Cannot map file: " + filename);
+    }
+    data = static_cast<const char*>(mapped);
+    // The destructor does not run if the constructor throws.
+    auto fail = [&](const std::string& message) {
+        munmap(const_cast<char*>(data), size);
+        data = nullptr;
+        throw std::runtime_error(message + filename);
+    };
+
+    size_t position = sizeof(dictionary_magic);
+    uint32_t version = read_u32(position);
+    if(std::memcmp(data, dictionary_magic, sizeof(dictionary_magic)) != 0 || version != dictionary_version){
+        fail("Not a dictionary encoded .sky file of this version: ");
+    }
+    n_x = static_cast<int32_t>(read_u32(position));
+    n_y = static_cast<int32_t>(read_u32(position));
+    for(auto* point : {&lower_bound, &upper_bound, &grid_step}){
+        point->first = read_double(position);
+        point->second = read_double(position);
+    }
+    size_t trailer = size - sizeof(uint64_t);
+    size_t dictionary_offset = read_u64(trailer);
+    if(n_x < 1 || n_y < 1 || dictionary_offset < position || dictionary_offset + sizeof(uint64_t) > size - sizeof(uint64_t)){
+        fail("Dictionary encoded .sky file is truncated: ");
+    }
+
+    size_t staircase = dictionary_offset;
+    uint64_t num_staircases = read_u64(staircase);
+    staircases.reserve(num_staircases);
+    for(uint64_t s = 0; s < num_staircases; s++){
+        if(staircase + sizeof(uint32_t) > size - sizeof(uint64_t)){
+            fail("Dictionary encoded .sky file is truncated: ");
+        }
+        staircases.push_back(staircase);
+        uint32_t num_relations = read_u32(staircase);
+        staircase += 2*sizeof(double)*num_relations;
+    }
+    if(staircase > size - sizeof(uint64_t)){
+        fail("Dictionary encoded .sky file is truncated: ");
+    }
+
+    cells.assign(static_cast<size_t>(n_x) * n_y, 0);
+    points.assign(static_cast<size_t>(n_x) * n_y, {0, 0});
+    // The grid point after the last run and its step, continued by runs without a stored point.
+    std::pair<double, double> point, step;
+    const size_t first_run = position;
+    while(position < dictionary_offset){
+        size_t run = position;
+        if(position + run_header_size > dictionary_offset){
+            fail("Dictionary encoded .sky file is truncated: ");
+        }
+        int i = static_cast<int32_t>(read_u32(position));
+        int j = static_cast<int32_t>(read_u32(position));
+        uint32_t length = read_u32(position);
+        uint32_t flags = read_u32(position);
+        if(flags & stored_point){
+            if(position + 4*sizeof(double) + sizeof(uint32_t) > dictionary_offset){
+                fail("Dictionary encoded .sky file is truncated: ");
+            }
+            point.first = read_double(position);
+            point.second = read_double(position);
+            step.first = read_double(position);
+            step.second = read_double(position);
+        } else if(run == first_run){
+            fail("Malformed run in dictionary encoded .sky file: ");
+        }
+        size_t factors = position;
+        uint32_t num_factors = read_u32(position);
+        if(i < 0 || j < 0 || j >= n_y || static_cast<uint64_t>(i) + length > static_cast<uint64_t>(n_x)
+            || position + factor_size * num_factors > dictionary_offset){
+            fail("Malformed run in dictionary encoded .sky file: ");
+        }
+        for(uint32_t s = 0; s < num_factors; s++){
+            size_t id_position = position + s * factor_size;
+            if(read_u32(id_position) >= num_staircases){
+                fail("Unknown staircase in dictionary encoded .sky file: ");
+            }
+        }
+        position += factor_size * num_factors;
+        for(uint32_t k = 0; k < length; k++){
+            cells[static_cast<size_t>(j) * n_x + i + k] = factors;
+            points[static_cast<size_t>(j) * n_x + i + k] = point;
+            point = next_point(point, step);
+        }
+    }
+}
+
+Sky_dictionary_file::~Sky_dictionary_file() {
+    if(data != nullptr){
+        munmap(const_cast<char*>(data), size);
+    }
+}
+
+bool Sky_dictionary_file::is_dictionary(const std::string& filename) {
+    std::ifstream file(filename, std::ios::binary);
+    char magic[sizeof(dictionary_magic)];
+    return file.read(magic, sizeof(magic)) && std::memcmp(magic, dictionary_magic, sizeof(dictionary_magic)) == 0;
+}
+
+uint32_t Sky_dictionary_file::read_u32(size_t& position) const {
+    uint32_t value;
+    std::memcpy(&value, data + position, sizeof(uint32_t));
+    position += sizeof(uint32_t);
+    return value;
+}
+
+uint64_t Sky_dictionary_file::read_u64(size_t& position) const {
+    uint64_t value;
+    std::memcpy(&value, data + position, sizeof(uint64_t));
+    position += sizeof(uint64_t);
+    return value;
+}
+
+double Sky_dictionary_file::read_double(size_t& position) const {
+    double value;
+    std::memcpy(&value, data + position, sizeof(double));
+    position += sizeof(double);
+    return value;
+}
+
+bool Sky_dictionary_file::has_cell(int i, int j) const {
+    return i >= 0 && i < n_x && j >= 0 && j < n_y && cells[static_cast<size_t>(j) * n_x + i] != 0;
+}
+
+std::pair<double, double> Sky_dictionary_file::grid_point(int i, int j) const {
+    return points[static_cast<size_t>(j) * n_x + i];
+}
+
+void sky_to_dictionary(const std::string& input, const std::string& output) {
+    std::ofstream out(output, std::ios::binary);
+    if(!out.is_open()){
+        throw std::runtime_error("Cannot open output file: " + output);
+    }
+    Sky_dictionary_builder builder(out);
+    if(Sky_binary_file::is_binary(input)){
+        Sky_binary_file file(input);
+        replay_cells(file, builder);
+        return;
+    }
+    std::ifstream in(input);
+    if(!in.is_open()){
+        throw std::runtime_error("Cannot open file: " + input);
+    }
+    Sky_text_parser parser(builder);
+    std::string line;
+    while(std::getline(in, line)){
+        parser.line(line);
+    }
+    builder.finish();
+}
+
+void sky_dictionary_to_text(const std::string& input, const std::string& output) {
+    Sky_dictionary_file file(input);
+    std::ofstream out(output);
+    if(!out.is_open()){
+        throw std::runtime_error("Cannot open output file: " + output);
+    }
+    Sky_text_writer writer(out);
+    replay_cells(file, writer);
+}
+
+} // namespace hnf
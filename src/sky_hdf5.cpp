@@ -0,0 +1,229 @@
+#include "sky_hdf5.hpp"
+#include "sky_dictionary.hpp"
+#include <H5Cpp.h>
+#include <cstdio>
+#include <limits>
+#include <stdexcept>
+
+namespace hnf {
+
+namespace {
+
+// H5::Exception is not a std::exception, the callers only know the latter.
+template<typename F>
+void hdf5_call(F f) {
+    try {
+        f();
+    } catch (const H5::Exception& e) {
+        throw std::runtime_error("HDF5: " + e.getFuncName() + ": " + e.getDetailMsg());
+    }
+}
+
+/**
+ * @brief A chunked, compressed dataset with columns columns which grows by whole chunks as values are appended.
+ */
+template<typename T>
+struct Appendable_dataset {
+    H5::DataSet dataset;
+    H5::PredType type;
+    int rank;
+    hsize_t columns;
+    size_t chunk_rows;
+    hsize_t rows = 0;
+    std::vector<T> buffer;
+
+    Appendable_dataset(H5::H5File& file, const std::string& name, const H5::PredType& type,
+        hsize_t columns, size_t chunk_rows)
+        : type(type), rank(columns == 1 ? 1 : 2), columns(columns), chunk_rows(chunk_rows) {
+        hsize_t dims[2] = {0, columns};
+        hsize_t max_dims[2] = {H5S_UNLIMITED, columns};
+        H5::DataSpace space(rank, dims, max_dims);
+        H5::DSetCreatPropList properties;
+        hsize_t chunk[2] = {chunk_rows, columns};
+        properties.setChunk(rank, chunk);
+        // Offsets and coordinates of neighbouring cells share most of their bytes.
+        properties.setShuffle();
+        properties.setDeflate(4);
+        dataset = file.createDataSet(name, type, space, properties);
+        buffer.reserve(chunk_rows * columns);
+    }
+
+    void push(T value) {
+        buffer.push_back(value);
+        if(buffer.size() >= chunk_rows * columns){
+            flush();
+        }
+    }
+
+    void flush() {
+        if(buffer.empty()){
+            return;
+        }
+        hsize_t count[2] = {buffer.size() / columns, columns};
+        hsize_t offset[2] = {rows, 0};
+        hsize_t new_dims[2] = {rows + count[0], columns};
+        dataset.extend(new_dims);
+        H5::DataSpace file_space = dataset.getSpace();
+        file_space.selectHyperslab(H5S_SELECT_SET, count, offset);
+        H5::DataSpace memory_space(rank, count);
+        dataset.write(buffer.data(), type, memory_space, file_space);
+        rows += count[0];
+        buffer.clear();
+    }
+};
+
+void write_attribute(H5::H5File& file, const std::string& name, int value) {
+    H5::Attribute attribute = file.createAttribute(name, H5::PredType::NATIVE_INT, H5::DataSpace(H5S_SCALAR));
+    attribute.write(H5::PredType::NATIVE_INT, &value);
+}
+
+void write_attribute(H5::H5File& file, const std::string& name, const std::pair<double, double>& value) {
+    hsize_t size = 2;
+    double values[2] = {value.first, value.second};
+    H5::Attribute attribute = file.createAttribute(name, H5::PredType::NATIVE_DOUBLE, H5::DataSpace(1, &size));
+    attribute.write(H5::PredType::NATIVE_DOUBLE, values);
+}
+
+} // namespace
+
+struct Sky_hdf5_writer::Datasets {
+    H5::H5File file;
+    Appendable_dataset<double> grid_points;
+    Appendable_dataset<uint64_t> cell_offsets;
+    Appendable_dataset<double> slopes;
+    Appendable_dataset<uint64_t> corner_offsets;
+    Appendable_dataset<double> corners;
+
+    Datasets(const std::string& path, size_t chunk_size)
+        : file(path, H5F_ACC_TRUNC),
+          grid_points(file, "grid_points", H5::PredType::NATIVE_DOUBLE, 2, chunk_size),
+          cell_offsets(file, "cell_offsets", H5::PredType::NATIVE_UINT64, 1, chunk_size),
+          slopes(file, "slopes", H5::PredType::NATIVE_DOUBLE, 1, chunk_size),
+          corner_offsets(file, "corner_offsets", H5::PredType::NATIVE_UINT64, 1, chunk_size),
+          corners(file, "corners", H5::PredType::NATIVE_DOUBLE, 2, chunk_size) {}
+};
+
+Sky_hdf5_writer::Sky_hdf5_writer(const std::string& path, size_t chunk_size) {
+    hdf5_call([&]() {
+        H5::Exception::dontPrint();
+        datasets = std::make_unique<Datasets>(path, chunk_size < 1 ? 1 : chunk_size);
+    });
+}
+
+Sky_hdf5_writer::~Sky_hdf5_writer() {
+    try {
+        finish();
+    } catch (...) {
+    }
+}
+
+void Sky_hdf5_writer::header(int n_x, int n_y,
+    const std::pair<double, double>& lower_bound,
+    const std::pair<double, double>& upper_bound,
+    const std::pair<double, double>& grid_step) {
+    this->n_x = n_x;
+    this->n_y = n_y;
+    hdf5_call([&]() {
+        write_attribute(datasets->file, "n_x", n_x);
+        write_attribute(datasets->file, "n_y", n_y);
+        write_attribute(datasets->file, "lower_bound", lower_bound);
+        write_attribute(datasets->file, "upper_bound", upper_bound);
+        write_attribute(datasets->file, "grid_step", grid_step);
+    });
+}
+
+void Sky_hdf5_writer::skip_cells_until(size_t cell_index) {
+    const double missing = std::numeric_limits<double>::quiet_NaN();
+    for(; next_cell < cell_index; next_cell++){
+        datasets->cell_offsets.push(num_factors);
+        datasets->grid_points.push(missing);
+        datasets->grid_points.push(missing);
+    }
+}
+
+void Sky_hdf5_writer::cell(int i, int j, double x, double y) {
+    if(i < 0 || i >= n_x || j < 0 || j >= n_y){
+        throw std::runtime_error("Grid point (" + std::to_string(i) + ", " + std::to_string(j) + ") outside of the grid");
+    }
+    size_t cell_index = static_cast<size_t>(j) * n_x + i;
+    if(cell_index < next_cell){
+        throw std::runtime_error("HDF5 output needs the grid points in increasing order, got ("
+            + std::to_string(i) + ", " + std::to_string(j) + ") too late");
+    }
+    hdf5_call([&]() {
+        skip_cells_until(cell_index);
+        datasets->cell_offsets.push(num_factors);
+        datasets->grid_points.push(x);
+        datasets->grid_points.push(y);
+    });
+    next_cell = cell_index + 1;
+    in_cell = true;
+}
+
+void Sky_hdf5_writer::factor(double slope, const std::vector<std::pair<double, double>>& relations) {
+    if(!in_cell){
+        throw std::runtime_error("Factor outside of a grid point");
+    }
+    hdf5_call([&]() {
+        datasets->slopes.push(slope);
+        datasets->corner_offsets.push(num_corners);
+        for(const auto& [x, y] : relations){
+            datasets->corners.push(x);
+            datasets->corners.push(y);
+        }
+    });
+    num_corners += relations.size();
+    num_factors++;
+}
+
+void Sky_hdf5_writer::finish() {
+    if(finished){
+        return;
+    }
+    finished = true;
+    hdf5_call([&]() {
+        skip_cells_until(static_cast<size_t>(n_x) * n_y);
+        datasets->cell_offsets.push(num_factors);
+        datasets->corner_offsets.push(num_corners);
+        datasets->grid_points.flush();
+        datasets->cell_offsets.flush();
+        datasets->slopes.flush();
+        datasets->corner_offsets.flush();
+        datasets->corners.flush();
+        datasets->file.close();
+    });
+}
+
+namespace {
+
+template<typename File>
+void indexed_to_hdf5(const std::string& input, const std::string& output) {
+    File file(input);
+    Sky_hdf5_writer writer(output);
+    replay_cells(file, writer);
+}
+
+} // namespace
+
+void sky_to_hdf5(const std::string& input, const std::string& output) {
+    if(Sky_binary_file::is_binary(input)){
+        indexed_to_hdf5<Sky_binary_file>(input, output);
+        return;
+    }
+    if(Sky_dictionary_file::is_dictionary(input)){
+        indexed_to_hdf5<Sky_dictionary_file>(input, output);
+        return;
+    }
+    // Older text files are not always in grid order, the index of the binary format puts them in order.
+    std::string temporary = output + ".skb.tmp";
+    try {
+        sky_text_to_binary(input, temporary);
+        indexed_to_hdf5<Sky_binary_file>(temporary, output);
+    } catch (...) {
+        std::remove(temporary.c_str());
+        throw;
+    }
+    std::remove(temporary.c_str());
+}
+
+} // namespace hnf
@@ -0,0 +1,116 @@
+#include "sky_stream_writer.hpp"
+#include <algorithm>
+#include <cstring>
+
+namespace hnf {
+
+Double_buffer::Double_buffer(const std::string& path, size_t block_size)
+    : filling(block_size < 1 ? 1 : block_size), writing(block_size < 1 ? 1 : block_size) {
+    if(path.empty()){
+        discard = true;
+    } else {
+        file = std::fopen(path.c_str(), "wb");
+    }
+    setp(filling.data(), filling.data() + filling.size());
+    if(file != nullptr){
+        writer = std::thread([this]() { writer_loop(); });
+    }
+}
+
+Double_buffer::~Double_buffer() {
+    close();
+}
+
+void Double_buffer::hand_over() {
+    size_t size = pptr() - pbase();
+    if(size == 0){
+        return;
+    }
+    if(file == nullptr){
+        setp(filling.data(), filling.data() + filling.size());
+        return;
+    }
+    std::unique_lock<std::mutex> lock(mutex);
+    cv.wait(lock, [this]() { return !pending; });
+    filling.swap(writing);
+    writing_size = size;
+    pending = true;
+    lock.unlock();
+    cv.notify_all();
+    setp(filling.data(), filling.data() + filling.size());
+}
+
+void Double_buffer::writer_loop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    while(true){
+        cv.wait(lock, [this]() { return pending || stopping; });
+        if(!pending){
+            return;
+        }
+        // The block is not touched by the filling side until pending is reset.
+        lock.unlock();
+        bool ok = std::fwrite(writing.data(), 1, writing_size, file) == writing_size;
+        lock.lock();
+        failed = failed || !ok;
+        pending = false;
+        cv.notify_all();
+    }
+}
+
+Double_buffer::int_type Double_buffer::overflow(int_type c) {
+    if(closed){
+        return traits_type::eof();
+    }
+    hand_over();
+    if(!traits_type::eq_int_type(c, traits_type::eof())){
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+std::streamsize Double_buffer::xsputn(const char* s, std::streamsize n) {
+    if(closed){
+        return 0;
+    }
+    std::streamsize written = 0;
+    while(written < n){
+        std::streamsize space = epptr() - pptr();
+        if(space == 0){
+            hand_over();
+            continue;
+        }
+        std::streamsize chunk = std::min(space, n - written);
+        std::memcpy(pptr(), s + written, chunk);
+        pbump(static_cast<int>(chunk));
+        written += chunk;
+    }
+    return written;
+}
+
+bool Double_buffer::close() {
+    if(closed){
+        return !failed;
+    }
+    hand_over();
+    closed = true;
+    if(file == nullptr){
+        return discard;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    cv.notify_all();
+    writer.join();
+    failed = std::fclose(file) != 0 || failed;
+    file = nullptr;
+    return !failed;
+}
+
+Sky_stream_writer::Sky_stream_writer(const std::string& path, size_t block_size)
+    : std::ostream(nullptr), buffer(path, block_size) {
+    rdbuf(&buffer);
+}
+
+} // namespace hnf
@@ -1,4 +1,8 @@
 #include "subdivision.hpp"
+#include "f2_matrix.hpp"
+#include "grassmannian_table.hpp"
+#include "hnf_at.hpp"
+#include "relation_staircase.hpp"
 
 namespace hnf {
 
@@ -282,22 +286,96 @@ std::vector<Segment_2> extract_segments_from_hull(const Polyhedron& hull,
 }
 
 
-void assign_face_data(Arrangement& arr, const Polyhedron& hull,
-                        const vec<SparseMatrix<int>>& subspaces,
-                     const std::vector<std::array<double,3>>& polynomials,
-                     const vec<R2Mat>& submodules,
-                     const std::map<Point_3, size_t>& point_to_index) {
-    CGAL::Arr_naive_point_location<Arrangement> pl(arr);
-    
-    //To-Do
+/**
+ * @brief Index of the scss at the shift (x, y), where polynomials[i] is the area per dimension of the subspace spanned by
+ * subspace_rows[i] without the term x*y/range_area which all of them share. Ties are broken by Scss_candidates, 
+ * so that the subdivision picks the same subspace as the search.
+ */
+size_t minimal_polynomial_at(const vec<std::array<double,3>>& polynomials, const vec<vec<uint64_t>>& subspace_rows,
+    double range_area, double x, double y) {
+    Scss_candidates candidates;
+    for (size_t i = 0; i < polynomials.size(); i++) {
+        double area = polynomials[i][0] + polynomials[i][1]*x + polynomials[i][2]*y + x*y/range_area;
+        candidates.offer(1 / area, subspace_rows[i]);
+    }
+    for (size_t i = 0; i < subspace_rows.size(); i++) {
+        if (subspace_rows[i] == candidates.winner()) {
+            return i;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Labels every bounded face with the scss at the centroid of its vertices, chosen by minimal_polynomial_at.
+ * Returns false if that polynomial is not minimal at all vertices of the face,
+ * i.e. the arrangement does not resolve the lower envelope, so that the labels cannot be trusted.
+ */
+bool assign_face_data(Arrangement& arr, const std::vector<std::array<double,3>>& polynomials,
+    const vec<vec<uint64_t>>& subspace_rows, double range_area) {
+    const double tolerance = 1e-9;
+    bool exact = true;
+    for (auto fit = arr.faces_begin(); fit != arr.faces_end(); ++fit) {
+        if (fit->is_unbounded()) continue;
+        vec<std::pair<double, double>> vertices;
+        auto ccb = fit->outer_ccb();
+        auto curr = ccb;
+        do {
+            auto pt = curr->source()->point();
+            vertices.emplace_back(CGAL::to_double(pt.x()), CGAL::to_double(pt.y()));
+            ++curr;
+        } while (curr != ccb);
+        double x = 0;
+        double y = 0;
+        for (const auto& [vx, vy] : vertices) {
+            x += vx;
+            y += vy;
+        }
+        x /= vertices.size();
+        y /= vertices.size();
+
+        size_t index = minimal_polynomial_at(polynomials, subspace_rows, range_area, x, y);
+        const auto& poly = polynomials[index];
+        for (const auto& [vx, vy] : vertices) {
+            const auto& minimum = polynomials[minimal_polynomial_at(polynomials, subspace_rows, range_area, vx, vy)];
+            double value = poly[0] + poly[1]*vx + poly[2]*vy;
+            double minimal_value = minimum[0] + minimum[1]*vx + minimum[2]*vy;
+            if (value > minimal_value + tolerance * (1 + std::abs(minimal_value))) {
+                exact = false;
+            }
+        }
+        face_data data;
+        data.subspace_index = static_cast<int>(index);
+        data.slope_polynomial = poly;
+        fit->set_data(data);
+    }
+    return exact;
+}
+
+/**
+ * @brief Checks if the points do not lie on a common plane, only then convex_hull_3 gives a polyhedron with upper facets.
+ */
+bool is_full_dimensional(const std::vector<Point_3>& points) {
+    for (size_t i = 1; i < points.size(); i++) {
+        if (points[i] == points[0]) continue;
+        for (size_t j = i + 1; j < points.size(); j++) {
+            if (CGAL::collinear(points[0], points[i], points[j])) continue;
+            for (size_t l = j + 1; l < points.size(); l++) {
+                if (!CGAL::coplanar(points[0], points[i], points[j], points[l])) {
+                    return true;
+                }
+            }
+            return false;
+        }
+        return false;
+    }
+    return false;
 }
 
 
-Arrangement subdivision_from_polynomials( const vec<SparseMatrix<int>>& subspaces,
-                                                const vec<std::array<double,3>>& polynomials,
-                                                 const vec<R2Mat>& submodules,
+Arrangement subdivision_from_polynomials( const vec<std::array<double,3>>& polynomials,
                                                  const r2degree& cell_start, 
-                                                 const r2degree& cell_end, const bool info = true) {
+                                                 const r2degree& cell_end, const bool info) {
     BoundingBox box{cell_start.first, cell_end.first, 
                            cell_start.second, cell_end.second};
     // Build convex hull in dual space
@@ -307,11 +385,16 @@ Arrangement subdivision_from_polynomials( const vec<SparseMatrix<int>>& subspace
         point_to_index[dual_points[i]] = i;
     }
     
-    Polyhedron hull;
-    CGAL::convex_hull_3(dual_points.begin(), dual_points.end(), hull);
+    // If all dual points lie on a plane the hull has no upper facets, then only the box is inserted 
+    // and assign_face_data decides whether a single face suffices.
+    std::vector<Segment_2> clipped_segments;
+    if (is_full_dimensional(dual_points)) {
+        Polyhedron hull;
+        CGAL::convex_hull_3(dual_points.begin(), dual_points.end(), hull);
     
-    // Extract and clip segments from hull
-    std::vector<Segment_2> clipped_segments = extract_segments_from_hull(hull, box, point_to_index, info);
+        // Extract and clip segments from hull
+        clipped_segments = extract_segments_from_hull(hull, box, point_to_index, info);
+    }
 
     if(info){
         for (const auto& seg : clipped_segments) {
@@ -330,16 +413,57 @@ Arrangement subdivision_from_polynomials( const vec<SparseMatrix<int>>& subspace
     CGAL::insert(arr, bbox_segments.begin(), bbox_segments.end());
     CGAL::insert(arr, clipped_segments.begin(), clipped_segments.end());
     
-    // Assign face data
-    assign_face_data(arr, hull, subspaces, polynomials, submodules, point_to_index);
-    
     return arr;
 }
 
 
-void compute_arrangement_quotients(vec<SparseMatrix<int>> subspaces){
-    //TO-DO implement
-};
+/**
+ * @brief Stores the scss of every face and the quotient by it, with their area polynomials in shifts of the generators of X.
+ * Quotients with more than one generator get their own subdivision of the same cell, 
+ * so that the whole filtration can be read off by repeated point location.
+ * Faces with the same subspace share one computation. Returns false if one of the nested subdivisions failed.
+ */
+bool compute_arrangement_quotients(Arrangement& arr,
+    const Uni_B1& X,
+    const vec<SparseMatrix<int>>& subspaces,
+    const vec<std::array<double,3>>& area_polynomials,
+    const pair<r2degree>& bounds,
+    const r2degree& cell_start,
+    const r2degree& cell_boundary){
+    int k = X.d1.get_num_rows();
+    std::map<int, face_data> by_subspace;
+    for (auto fit = arr.faces_begin(); fit != arr.faces_end(); ++fit) {
+        if (fit->is_unbounded()) continue;
+        int index = fit->data().subspace_index;
+        auto it = by_subspace.find(index);
+        if (it == by_subspace.end()) {
+            face_data data = fit->data();
+            const SparseMatrix<int>& subspace = subspaces[index];
+            if (subspace.get_num_cols() == k) {
+                // X is semistable on this face.
+                data.submodule = std::make_unique<Uni_B1>(X);
+            } else {
+                data.submodule = std::make_unique<Uni_B1>(f2_submodule_generated_by(X.d1, subspace));
+                R2Mat quotient = X.d1;
+                f2_quotient_by(quotient, subspace);
+                data.quotient = std::make_unique<Uni_B1>(std::move(quotient), true);
+                if (data.quotient->d1.get_num_rows() > 1) {
+                    data.quotient_subdivision = compute_cell_subdivision(*data.quotient, bounds, cell_start, cell_boundary);
+                    if (!data.quotient_subdivision) {
+                        return false;
+                    }
+                } else {
+                    Relation_staircase staircase(data.quotient->d1, bounds);
+                    data.quotient->area_polynomial = staircase.area_polynomial({1});
+                }
+            }
+            data.submodule->area_polynomial = area_polynomials[index];
+            it = by_subspace.emplace(index, std::move(data)).first;
+        }
+        fit->set_data(it->second);
+    }
+    return true;
+}
 
 
 Slope_subdivision compute_slope_subdivision(Uni_B1& res, 
@@ -354,11 +478,11 @@ Slope_subdivision compute_slope_subdivision(Uni_B1& res,
         return Slope_subdivision(Arrangement());
     }
     vec<std::array<double, 3>> slope_polynomials;
+    vec<vec<uint64_t>> subspace_rows;
     if(subspaces.size() < k){
             std::cerr << "Have not loaded enough subspaces" << std::endl;
             std::exit(1);
     }
-    vec<R2Mat> submodules = vec<R2Mat>();
     for(size_t i = 1; i < subspaces[k-1].size(); i++){
         //skip i = 0, because it is the empty space
         auto ungraded_subspace = subspaces[k-1][i];
@@ -368,21 +492,223 @@ Slope_subdivision compute_slope_subdivision(Uni_B1& res,
         subspace.col_degrees = vec<r2degree>(num_gens, X.row_degrees[0]);
             assert(subspace.get_num_rows() == X.get_num_rows());
             assert(subspace.get_num_cols() == num_gens);
-        submodules.emplace_back(X.submodule_generated_by(subspace));
+        R2Mat submodule = X.submodule_generated_by(subspace);
         X.column_reduction_graded(); //full minimisation should not be necessary
-        Uni_B1 res(submodules.back());
+        Uni_B1 res(submodule);
         res.compute_area_polynomial(bounds);  // Compute first
         slope_polynomials.emplace_back(res.area_polynomial);
+        subspace_rows.push_back(F2_matrix(ungraded_subspace).columns);
         for(auto& coeff : slope_polynomials.back()){
             coeff /= static_cast<double>(num_gens);
         }
     }
 
-    Arrangement arr = subdivision_from_polynomials(subspaces[k-1], slope_polynomials, submodules, cell_start, cell_boundary);
-    Slope_subdivision result(arr);
-    compute_arrangement_quotients(subspaces[k-1]);
+    Arrangement arr = subdivision_from_polynomials(slope_polynomials, cell_start, cell_boundary);
+    r2degree range = bounds.second - bounds.first;
+    if (!assign_face_data(arr, slope_polynomials, subspace_rows, range.first * range.second)) {
+        std::cerr << "Warning: the arrangement does not resolve the lower envelope of the slope polynomials." << std::endl;
+    }
+    return Slope_subdivision(std::move(arr));
+}
 
-    return result;
+std::shared_ptr<const Slope_subdivision> compute_cell_subdivision(const Uni_B1& X,
+    const pair<r2degree>& bounds,
+    const r2degree& cell_start,
+    const r2degree& cell_boundary) {
+    int k = X.d1.get_num_rows();
+    if (k < 2 || k > Grassmannian_table::max_dim) {
+        return nullptr;
+    }
+    // As in the sweep, the module at a point of the cell is X with all generators moved to that point.
+    Uni_B1 cut_off(X);
+    cut_off.d1.set_all_generator_degrees(cell_start);
+    const R2Mat& M = cut_off.d1;
+    r2degree extent = cell_boundary - cell_start;
+    if (!(extent.first > 0 && extent.second > 0)) {
+        return nullptr;
+    }
+    Relation_staircase staircase(M, bounds);
+    if (!staircase.bounded()) {
+        return nullptr;
+    }
+
+    // The polynomials are in the shift of the generators, so the cell is [0, extent].
+    const vec<vec<SparseMatrix<int>>>& table = Grassmannian_table::get(k);
+    vec<SparseMatrix<int>> subspaces;
+    vec<std::array<double,3>> area_polynomials;
+    vec<std::array<double,3>> slope_polynomials;
+    vec<vec<uint64_t>> subspace_rows;
+    for (int d = 1; d <= k; d++) {
+        for (const SparseMatrix<int>& subspace : table[d]) {
+            subspaces.push_back(subspace);
+            subspace_rows.push_back(F2_matrix(subspace).columns);
+            area_polynomials.push_back(staircase.area_polynomial(subspace_rows.back()));
+            slope_polynomials.push_back(area_polynomials.back());
+            for (double& coeff : slope_polynomials.back()) {
+                coeff /= static_cast<double>(d);
+            }
+        }
+    }
+
+    auto subdivision = std::make_shared<Slope_subdivision>(
+        subdivision_from_polynomials(slope_polynomials, r2degree(0, 0), extent, false));
+    r2degree range = bounds.second - bounds.first;
+    if (!assign_face_data(subdivision->arr, slope_polynomials, subspace_rows, range.first * range.second)) {
+        return nullptr;
+    }
+    if (!compute_arrangement_quotients(subdivision->arr, cut_off, subspaces, area_polynomials, bounds, cell_start, cell_boundary)) {
+        return nullptr;
+    }
+    return subdivision;
+}
+
+const face_data* Slope_subdivision::locate(const r2degree& point) const {
+    auto location = locator.locate(Point_2(point.first, point.second));
+    Arrangement::Face_const_handle face;
+    bool found = false;
+    if (const Arrangement::Face_const_handle* f = boost::get<Arrangement::Face_const_handle>(&location)) {
+        face = *f;
+        found = true;
+    } else if (const Arrangement::Halfedge_const_handle* e = boost::get<Arrangement::Halfedge_const_handle>(&location)) {
+        face = (*e)->face()->is_unbounded() ? (*e)->twin()->face() : (*e)->face();
+        found = true;
+    } else if (const Arrangement::Vertex_const_handle* v = boost::get<Arrangement::Vertex_const_handle>(&location)) {
+        if (!(*v)->is_isolated()) {
+            auto first = (*v)->incident_halfedges();
+            auto curr = first;
+            do {
+                if (!curr->face()->is_unbounded()) {
+                    face = curr->face();
+                    found = true;
+                    break;
+                }
+            } while (++curr != first);
+        }
+    }
+    if (!found || face->is_unbounded()) {
+        return nullptr;
+    }
+    return &face->data();
+}
+
+bool hnf_from_subdivision(const Slope_subdivision& subdivision,
+    const r2degree& shift,
+    const pair<r2degree>& bounds,
+    HN_factors& factors) {
+    factors.clear();
+    const Slope_subdivision* current = &subdivision;
+    while (true) {
+        const face_data* face = current->locate(shift);
+        if (!face || !face->submodule) {
+            factors.clear();
+            return false;
+        }
+        factors.push_back(*face->submodule);
+        factors.back().slope_value = factors.back().evaluate_slope_polynomial(shift, bounds);
+        if (!face->quotient) {
+            return true;
+        }
+        if (face->quotient_subdivision) {
+            current = face->quotient_subdivision.get();
+        } else {
+            factors.push_back(*face->quotient);
+            factors.back().slope_value = factors.back().evaluate_slope_polynomial(shift, bounds);
+            return true;
+        }
+    }
+}
+
+/**
+ * @brief One face of a region file: the factor, the number of its intervals, whether regions of a quotient follow, 
+ * and the vertices; then one line per interval with its relations.
+ */
+void write_region_face(std::ostream& ostream,
+    const Uni_B1& factor,
+    const vec<std::pair<double, double>>& vertices,
+    bool has_quotient,
+    const r2degree& cell_start) {
+    // Within a cell no relation changes its position relative to the generators, so the intervals are the same everywhere.
+    Uni_B1 cut_off(factor);
+    cut_off.d1.set_all_generator_degrees(cell_start);
+    HN_factors intervals;
+    if (cut_off.d1.get_num_rows() == 1) {
+        cut_off.d1.column_reduction_graded();
+        intervals.push_back(std::move(cut_off));
+    } else {
+        intervals = split_into_intervals(cut_off);
+    }
+    ostream << "F," << factor.d1.get_num_rows();
+    for (double coeff : factor.area_polynomial) {
+        ostream << "," << coeff;
+    }
+    ostream << "," << intervals.size() << "," << has_quotient << "," << vertices.size();
+    for (const auto& [x, y] : vertices) {
+        ostream << "," << x << ";" << y;
+    }
+    ostream << "\n";
+    for (const Uni_B1& interval : intervals) {
+        ostream << "I";
+        for (const r2degree& d : interval.d1.col_degrees) {
+            ostream << ",(" << d.first << ";" << d.second << ")";
+        }
+        ostream << "\n";
+    }
+}
+
+/**
+ * @brief A single face covering the whole cell.
+ */
+void write_cell_region(std::ostream& ostream, const Uni_B1& factor, const r2degree& cell_start, const r2degree& cell_boundary) {
+    r2degree extent = cell_boundary - cell_start;
+    ostream << "D,1\n";
+    write_region_face(ostream, factor, {{0, 0}, {extent.first, 0}, {extent.first, extent.second}, {0, extent.second}}, false, cell_start);
+}
+
+void write_subdivision_regions(std::ostream& ostream,
+    const Slope_subdivision& subdivision,
+    const r2degree& cell_start,
+    const r2degree& cell_boundary) {
+    const Arrangement& arr = subdivision.arr;
+    size_t num_faces = 0;
+    for (auto fit = arr.faces_begin(); fit != arr.faces_end(); ++fit) {
+        num_faces += !fit->is_unbounded();
+    }
+    ostream << "D," << num_faces << "\n";
+    for (auto fit = arr.faces_begin(); fit != arr.faces_end(); ++fit) {
+        if (fit->is_unbounded()) continue;
+        const face_data& data = fit->data();
+        vec<std::pair<double, double>> vertices;
+        auto ccb = fit->outer_ccb();
+        auto curr = ccb;
+        do {
+            auto pt = curr->source()->point();
+            vertices.emplace_back(CGAL::to_double(pt.x()), CGAL::to_double(pt.y()));
+            ++curr;
+        } while (curr != ccb);
+        write_region_face(ostream, *data.submodule, vertices, data.quotient != nullptr, cell_start);
+        if (data.quotient_subdivision) {
+            write_subdivision_regions(ostream, *data.quotient_subdivision, cell_start, cell_boundary);
+        } else if (data.quotient) {
+            write_cell_region(ostream, *data.quotient, cell_start, cell_boundary);
+        }
+    }
+}
+
+bool write_summand_regions(std::ostream& ostream,
+    const Uni_B1& summand,
+    const Slope_subdivision* subdivision,
+    const r2degree& cell_start,
+    const r2degree& cell_boundary) {
+    if (summand.d1.get_num_rows() == 1) {
+        write_cell_region(ostream, summand, cell_start, cell_boundary);
+        return true;
+    }
+    if (!subdivision) {
+        ostream << "D,0\n";
+        return false;
+    }
+    write_subdivision_regions(ostream, *subdivision, cell_start, cell_boundary);
+    return true;
 }
 
 void Slope_subdivision::export_to_svg(const std::string& filename,
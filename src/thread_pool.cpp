@@ -0,0 +1,155 @@
+#include "thread_pool.hpp"
+#include <algorithm>
+
+namespace hnf {
+
+namespace {
+thread_local int current_worker_index = -1;
+}
+
+Thread_pool::Thread_pool(int num_threads) {
+    if(num_threads < 1){
+        num_threads = 1;
+    }
+    workers.reserve(num_threads);
+    for(int i = 0; i < num_threads; i++){
+        workers.emplace_back([this, i]() { worker_loop(i); });
+    }
+}
+
+Thread_pool::~Thread_pool() {
+    {
+        std::lock_guard<std::mutex> lock(queue_mutex);
+        stopping = true;
+    }
+    queue_cv.notify_all();
+    for(auto& worker : workers){
+        worker.join();
+    }
+}
+
+int Thread_pool::worker_index() {
+    return current_worker_index;
+}
+
+void Thread_pool::worker_loop(int index) {
+    current_worker_index = index;
+    while(true){
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(queue_mutex);
+            queue_cv.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if(stopping && tasks.empty()){
+                return;
+            }
+            task = std::move(tasks.front());
+            tasks.pop();
+        }
+        task();
+    }
+}
+
+Work_stealing_pool::Work_stealing_pool(int num_threads) {
+    if(num_threads < 1){
+        num_threads = 1;
+    }
+    for(int i = 0; i < num_threads; i++){
+        deques.emplace_back(std::make_unique<Task_deque>());
+    }
+    workers.reserve(num_threads);
+    for(int i = 0; i < num_threads; i++){
+        workers.emplace_back([this, i]() { worker_loop(i); });
+    }
+}
+
+Work_stealing_pool::~Work_stealing_pool() {
+    {
+        std::lock_guard<std::mutex> lock(batch_mutex);
+        stopping = true;
+    }
+    batch_cv.notify_all();
+    for(auto& worker : workers){
+        worker.join();
+    }
+}
+
+void Work_stealing_pool::run_batch(std::vector<Prioritised_task>& tasks) {
+    if(tasks.empty()){
+        return;
+    }
+    std::stable_sort(tasks.begin(), tasks.end(), [](const Prioritised_task& a, const Prioritised_task& b) {
+        return a.cost > b.cost;
+    });
+    remaining = tasks.size();
+    for(size_t i = 0; i < tasks.size(); i++){
+        Task_deque& deque = *deques[i % deques.size()];
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        deque.tasks.emplace_back(std::move(tasks[i]));
+    }
+    tasks.clear();
+    {
+        std::lock_guard<std::mutex> lock(batch_mutex);
+        batch_generation++;
+    }
+    batch_cv.notify_all();
+
+    std::unique_lock<std::mutex> lock(batch_mutex);
+    done_cv.wait(lock, [this]() { return remaining.load() == 0; });
+    if(first_error){
+        std::exception_ptr error = first_error;
+        first_error = nullptr;
+        std::rethrow_exception(error);
+    }
+}
+
+bool Work_stealing_pool::pop_or_steal(int index, Prioritised_task& task) {
+    int num_deques = deques.size();
+    // Start with the own deque, then go round the others.
+    for(int offset = 0; offset < num_deques; offset++){
+        Task_deque& deque = *deques[(index + offset) % num_deques];
+        std::lock_guard<std::mutex> lock(deque.mutex);
+        if(!deque.tasks.empty()){
+            task = std::move(deque.tasks.front());
+            deque.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+void Work_stealing_pool::worker_loop(int index) {
+    current_worker_index = index;
+    size_t seen_generation = 0;
+    while(true){
+        {
+            std::unique_lock<std::mutex> lock(batch_mutex);
+            batch_cv.wait(lock, [&]() { return stopping || batch_generation != seen_generation; });
+            if(stopping){
+                return;
+            }
+            seen_generation = batch_generation;
+        }
+        Prioritised_task task;
+        while(pop_or_steal(index, task)){
+            try {
+                task.run(index);
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(batch_mutex);
+                if(!first_error){
+                    first_error = std::current_exception();
+                }
+            }
+            if(remaining.fetch_sub(1) == 1){
+                std::lock_guard<std::mutex> lock(batch_mutex);
+                done_cv.notify_all();
+            }
+        }
+    }
+}
+
+int default_num_threads() {
+    unsigned int hardware = std::thread::hardware_concurrency();
+    return hardware == 0 ? 1 : static_cast<int>(hardware);
+}
+
+} // namespace hnf
@@ -204,7 +204,8 @@ double Uni_B1::evaluate_area_polynomial(r2degree d, const pair<r2degree>& bounds
     double range_area = (bounds.second.first - bounds.first.first) * (bounds.second.second - bounds.first.second);
     double& x = d.first;
     double& y = d.second;
-    return area_polynomial[0] + area_polynomial[1]*x + area_polynomial[2]*y + x*y/range_area;
+    double k = this->d1.get_num_rows();
+    return area_polynomial[0] + area_polynomial[1]*x + area_polynomial[2]*y + k*x*y/range_area;
 }
 
 double Uni_B1::evaluate_slope_polynomial(r2degree d, const pair<r2degree>& bounds) {
@@ -212,7 +213,7 @@ double Uni_B1::evaluate_slope_polynomial(r2degree d, const pair<r2degree>& bound
     double& x = d.first;
     double& y = d.second;
     double k = this->d1.get_num_rows();
-    return k / (area_polynomial[0] + area_polynomial[1]*x + area_polynomial[2]*y + x*y/range_area);
+    return k / (area_polynomial[0] + area_polynomial[1]*x + area_polynomial[2]*y + k*x*y/range_area);
 }
 
 
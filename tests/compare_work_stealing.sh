@@ -0,0 +1,19 @@
+#!/bin/sh
+# Checks that the work-stealing sweep (-n -w) writes the same .sky file as the serial sweep, byte for byte.
+PROGRAM="${1:-./build/hnf_main}"
+INPUT="${2:-example_files/presentations/torus1.scc}"
+RESOLUTION="${3:-50,50}"
+
+TMP=$(mktemp -d)
+trap 'rm -rf "$TMP"' EXIT
+
+"$PROGRAM" "$INPUT" -l -r "$RESOLUTION" -o "$TMP/serial.sky" > /dev/null || exit 1
+"$PROGRAM" "$INPUT" -l -r "$RESOLUTION" -n 4 -w -o "$TMP/work_stealing.sky" > /dev/null || exit 1
+
+if cmp -s "$TMP/serial.sky" "$TMP/work_stealing.sky"; then
+    echo "Work-stealing output is identical to the serial output for $INPUT"
+else
+    echo "Work-stealing output differs from the serial output for $INPUT"
+    diff "$TMP/serial.sky" "$TMP/work_stealing.sky" | head -20
+    exit 1
+fi